@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+// Keeps the optimizer from dropping the computation
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs fn until at least minTime passed, returns the average time of a single call in ns
+template<typename Fn>
+double TimeIt(Fn&& fn, std::chrono::milliseconds minTime = std::chrono::milliseconds(200))
+{
+    using Clock = std::chrono::steady_clock;
+    size_t iterations{};
+    auto begin = Clock::now();
+    auto elapsed = Clock::duration{};
+    do {
+        fn();
+        ++iterations;
+        elapsed = Clock::now() - begin;
+    } while(elapsed < minTime);
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// Collects the results, prints them as a table or as JSON lines for regression tracking
+class Reporter
+{
+public:
+    struct Result
+    {
+        std::string name;
+        std::string param;
+        double value;
+        std::string unit;
+    };
+    void Add(std::string name, std::string param, double value, std::string unit)
+    {
+        results_.push_back({std::move(name), std::move(param), value, std::move(unit)});
+    }
+    void AddThroughput(std::string name, std::string param, size_t bytes, double ns)
+    {
+        Add(std::move(name), std::move(param), bytes * 1000.0 / ns, "MB/s");
+    }
+    void PrintText(std::ostream& out) const
+    {
+        for(auto& r : results_) {
+            out << std::left << std::setw(32) << r.name << std::setw(24) << r.param << std::right << std::setw(12)
+                << std::fixed << std::setprecision(1) << r.value << ' ' << r.unit << '\n';
+        }
+    }
+    void PrintJson(std::ostream& out) const
+    {
+        for(auto& r : results_) {
+            out << "{\"name\":\"" << r.name << "\",\"param\":\"" << r.param << "\",\"value\":" << std::fixed
+                << std::setprecision(3) << r.value << ",\"unit\":\"" << r.unit << "\"}\n";
+        }
+    }
+private:
+    std::vector<Result> results_;
+};
+
+void RunCrc(Reporter& reporter);
+void RunCodec(Reporter& reporter);
+void RunCapture(Reporter& reporter);
+void RunRoundTrip(Reporter& reporter);
+
+} // Bench
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.h"
+#include "capturedecoder.h"
+#include "wsp32.h"
+
+#include <random>
+
+namespace Bench {
+
+namespace {
+
+constexpr size_t CAPTURE_SIZE = 64 << 20;
+constexpr unsigned ESCAPE_PERCENTS[] = {0, 1, 10};
+
+} // namespace
+
+void RunCapture(Reporter& reporter)
+{
+    std::mt19937 rng{2};
+    for(auto escapes : ESCAPE_PERCENTS) {
+        std::vector<uint8_t> capture;
+        capture.reserve(CAPTURE_SIZE + Wk::MAX_FRAME_SIZE);
+        uint8_t data[Wk::Packet_t::BUF_SIZE];
+        uint8_t frame[Wk::MAX_FRAME_SIZE];
+        while(capture.size() < CAPTURE_SIZE) {
+            auto n = static_cast<uint8_t>(rng() % sizeof(data));
+            for(size_t i{}; i < n; ++i) {
+                do {
+                    data[i] = static_cast<uint8_t>(rng());
+                } while(data[i] == Wk::FEND || data[i] == Wk::FESC);
+                if(rng() % 100 < escapes) {
+                    data[i] = Wk::FEND;
+                }
+            }
+            uint8_t crc;
+            auto size = Wk::EncodeFrame(static_cast<uint8_t>(rng() % 0x80), Wk::C_ECHO, n, data, frame, crc);
+            capture.insert(capture.end(), frame, frame + size);
+        }
+        size_t frames{};
+        auto ns = TimeIt([&] {
+            Wk::CaptureDecoder decoder{capture.data(), capture.size()};
+            Wk::FrameView view;
+            frames = 0;
+            while(decoder.Next(view)) {
+                frames += view.crcOk;
+            }
+        });
+        auto param = "64MiB esc=" + std::to_string(escapes) + "%";
+        reporter.AddThroughput("Capture decode", param, capture.size(), ns);
+        reporter.Add("Capture decode rate", param, frames * 1e9 / ns, "frames/s");
+    }
+}
+
+} // Bench
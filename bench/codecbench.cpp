@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.h"
+#include "memoryport.h"
+#include "wsp32.h"
+
+#include <random>
+
+namespace Bench {
+
+namespace {
+
+constexpr uint8_t NODE_ADDR = 0x21;
+constexpr uint8_t GROUP_ADDR = Wk::ADDR_GROUP_MIN;
+constexpr size_t PAYLOAD_SIZES[] = {0, 4, 16, 64, 160};
+constexpr unsigned ESCAPE_PERCENTS[] = {0, 5, 50};
+
+Wk::Packet_t MakePacket(uint8_t addr, size_t size, unsigned escapePercent, std::mt19937& rng)
+{
+    Wk::Packet_t packet;
+    packet.addr = addr;
+    packet.cmd = Wk::C_ECHO;
+    packet.n = static_cast<uint8_t>(size);
+    for(size_t i{}; i < size; ++i) {
+        if(rng() % 100 < escapePercent) {
+            packet.payload[i] = rng() & 1 ? Wk::FEND : Wk::FESC;
+        }
+        else {
+            do {
+                packet.payload[i] = static_cast<uint8_t>(rng());
+            } while(packet.payload[i] == Wk::FEND || packet.payload[i] == Wk::FESC);
+        }
+    }
+    return packet;
+}
+
+std::string Param(size_t size, unsigned escapePercent)
+{
+    return "n=" + std::to_string(size) + " esc=" + std::to_string(escapePercent) + "%";
+}
+
+} // namespace
+
+void RunCodec(Reporter& reporter)
+{
+    std::mt19937 rng{1};
+    // Group address: Request() is TxFrame only, the port discards the output
+    for(auto size : PAYLOAD_SIZES) {
+        for(auto escapes : ESCAPE_PERCENTS) {
+            MemoryPort port;
+            Wk::Wake wake{port};
+            const auto packet = MakePacket(GROUP_ADDR, size, escapes, rng);
+            auto copy = packet;
+            wake.Request(copy);
+            const auto wireSize = port.GetWritten();
+            // Request() only clears n, the payload stays as it was
+            auto ns = TimeIt([&] {
+                copy.addr = packet.addr;
+                copy.cmd = packet.cmd;
+                copy.n = packet.n;
+                DoNotOptimize(wake.Request(copy));
+            });
+            reporter.AddThroughput("TxFrame encode", Param(size, escapes), wireSize, ns);
+            reporter.Add("TxFrame encode rate", Param(size, escapes), 1e9 / ns, "frames/s");
+        }
+    }
+    // Replies are replayed from memory, so Request() is a short TxFrame and a full RxFrame
+    for(auto size : PAYLOAD_SIZES) {
+        for(auto escapes : ESCAPE_PERCENTS) {
+            auto reply = MakePacket(NODE_ADDR, size, escapes, rng);
+            std::vector<uint8_t> stream(Wk::MAX_FRAME_SIZE);
+            uint8_t crc;
+            stream.resize(
+              Wk::EncodeFrame(reply.addr, reply.cmd, reply.n, reply.payload.data(), stream.data(), crc));
+            auto frameSize = stream.size();
+            // Request() drops the input left from the previous exchange, a read returns one reply
+            MemoryPort port{stream, frameSize};
+            Wk::Wake wake{port};
+            bool ok = true;
+            Wk::Packet_t packet;
+            auto ns = TimeIt([&] {
+                packet.addr = NODE_ADDR;
+                packet.cmd = Wk::C_ECHO;
+                packet.n = 0;
+                ok &= wake.Request(packet);
+            });
+            if(!ok) {
+                std::cerr << "RxFrame decode " << Param(size, escapes) << ": frame error\n";
+            }
+            reporter.AddThroughput("RxFrame decode", Param(size, escapes), frameSize, ns);
+            reporter.Add("RxFrame decode rate", Param(size, escapes), 1e9 / ns, "frames/s");
+        }
+    }
+}
+
+} // Bench
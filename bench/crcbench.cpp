@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.h"
+#include "crc8.h"
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+using namespace Mcudrv::Crc;
+
+namespace {
+
+constexpr size_t BUF_SIZE = 1 << 20;
+
+template<typename CrcType>
+typename CrcType::Value Compute(const std::vector<uint8_t>& buf)
+{
+    CrcType crc;
+    crc.Reset(0);
+    crc(buf.data(), buf.size());
+    return crc.GetResult();
+}
+
+// The wider CRCs against their own bytewise kernel
+template<typename CrcType>
+void RunKernels(Reporter& reporter, const char* name, const std::vector<uint8_t>& buf)
+{
+    const auto reference = CrcType::UpdateBytewise(0, buf.data(), buf.size());
+    struct
+    {
+        const char* kernel;
+        typename CrcType::Engine engine;
+    } engines[] = {{" bytewise", CrcType::UpdateBytewise},
+                   {" slicing-by-4", CrcType::UpdateSlicing4},
+                   {" slicing-by-8", CrcType::UpdateSlicing8}};
+    for(auto& [kernel, engine] : engines) {
+        auto fullName = std::string{name} + kernel;
+        if(engine(0, buf.data(), buf.size()) != reference) {
+            std::cerr << fullName << ": result mismatch\n";
+        }
+        reporter.AddThroughput(fullName, "1MiB", buf.size(),
+                               TimeIt([&] { DoNotOptimize(engine(0, buf.data(), buf.size())); }));
+    }
+}
+
+} // namespace
+
+void RunCrc(Reporter& reporter)
+{
+    std::vector<uint8_t> buf(BUF_SIZE);
+    for(size_t i{}; i < buf.size(); ++i) {
+        buf[i] = static_cast<uint8_t>(i * 2654435761U >> 13);
+    }
+    const auto reference = Compute<NoLUT::Crc8<NoLUT::Crc8_Algo1>>(buf);
+    struct
+    {
+        const char* name;
+        Crc8::Engine engine;
+    } engines[] = {{"Crc8 bytewise", Crc8::UpdateBytewise},
+                   {"Crc8 slicing-by-4", Crc8::UpdateSlicing4},
+                   {"Crc8 slicing-by-8", Crc8::UpdateSlicing8}};
+    for(auto& [name, engine] : engines) {
+        if(engine(0, buf.data(), buf.size()) != reference) {
+            std::cerr << name << ": result mismatch\n";
+        }
+        reporter.AddThroughput(name, "1MiB", buf.size(),
+                               TimeIt([&] { DoNotOptimize(engine(0, buf.data(), buf.size())); }));
+    }
+    reporter.AddThroughput("Crc8 auto", "1MiB", buf.size(), TimeIt([&] { DoNotOptimize(Compute<Crc8>(buf)); }));
+    reporter.AddThroughput("NoLUT Crc8_Algo1", "1MiB", buf.size(),
+                           TimeIt([&] { DoNotOptimize(Compute<NoLUT::Crc8<NoLUT::Crc8_Algo1>>(buf)); }));
+    const auto algo2 = Compute<NoLUT::Crc8<NoLUT::Crc8_Algo2>>(buf);
+    if(algo2 != reference) {
+        std::cerr << "NoLUT Crc8_Algo2: result mismatch\n";
+    }
+    reporter.AddThroughput("NoLUT Crc8_Algo2", "1MiB", buf.size(),
+                           TimeIt([&] { DoNotOptimize(Compute<NoLUT::Crc8<NoLUT::Crc8_Algo2>>(buf)); }));
+    RunKernels<Crc16Ccitt>(reporter, "Crc16Ccitt", buf);
+    RunKernels<Crc32>(reporter, "Crc32", buf);
+    RunKernels<Crc64Xz>(reporter, "Crc64Xz", buf);
+}
+
+} // Bench
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.h"
+#include <string_view>
+
+int main(int argc, const char* argv[])
+{
+    bool json{};
+    bool crc{}, codec{}, capture{}, roundTrip{};
+    for(int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if(arg == "-j") {
+            json = true;
+        }
+        else if(arg == "crc") {
+            crc = true;
+        }
+        else if(arg == "codec") {
+            codec = true;
+        }
+        else if(arg == "capture") {
+            capture = true;
+        }
+        else if(arg == "roundtrip") {
+            roundTrip = true;
+        }
+        else {
+            std::cout << "Usage: wakebench [-j] [crc] [codec] [capture] [roundtrip]\r\n"
+                         "    -j - JSON lines output, all the suites run if none is given\r\n";
+            return arg == "-h" ? 0 : 1;
+        }
+    }
+    if(!crc && !codec && !capture && !roundTrip) {
+        crc = codec = capture = roundTrip = true;
+    }
+    Bench::Reporter reporter;
+    if(crc) {
+        Bench::RunCrc(reporter);
+    }
+    if(codec) {
+        Bench::RunCodec(reporter);
+    }
+    if(capture) {
+        Bench::RunCapture(reporter);
+    }
+#ifdef __linux__
+    if(roundTrip) {
+        Bench::RunRoundTrip(reporter);
+    }
+#endif
+    if(json) {
+        reporter.PrintJson(std::cout);
+    }
+    else {
+        reporter.PrintText(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "iserialport.h"
+#include <string.h>
+#include <vector>
+
+namespace Bench {
+
+// Writes go nowhere, reads replay the given byte stream in a loop, in blocks of up to chunkSize
+class MemoryPort : public ISerialPort
+{
+public:
+    explicit MemoryPort(std::vector<uint8_t> stream = {}, size_t chunkSize = 4096) :
+      stream_{std::move(stream)}, chunkSize_{chunkSize}
+    { }
+    bool AccessCOM() override
+    {
+        return true;
+    }
+    bool OpenCOM() override
+    {
+        return true;
+    }
+    bool CloseCOM() override
+    {
+        return true;
+    }
+    bool WriteData(const uint8_t*, uint32_t size) override
+    {
+        written_ += size;
+        return true;
+    }
+    bool WriteDataV(const IoSegment* segments, size_t count) override
+    {
+        for(size_t i{}; i < count; ++i) {
+            written_ += segments[i].size;
+        }
+        return true;
+    }
+    bool ReadData(uint8_t* data, uint32_t size) override
+    {
+        return ReadSome(data, size) == size;
+    }
+    uint32_t ReadSome(uint8_t* data, uint32_t size) override
+    {
+        if(stream_.empty()) {
+            return 0;
+        }
+        size_t total{};
+        size_t limit = size < chunkSize_ ? size : chunkSize_;
+        while(total < limit) {
+            auto chunk = stream_.size() - position_;
+            if(chunk > limit - total) {
+                chunk = limit - total;
+            }
+            memcpy(data + total, stream_.data() + position_, chunk);
+            total += chunk;
+            position_ = (position_ + chunk) % stream_.size();
+        }
+        return static_cast<uint32_t>(total);
+    }
+    bool ResetStatus() override
+    {
+        return true;
+    }
+    bool Flush() override
+    {
+        return true;
+    }
+    bool SetTimeout(uint32_t) override
+    {
+        return true;
+    }
+    size_t GetWritten() const
+    {
+        return written_;
+    }
+private:
+    std::vector<uint8_t> stream_;
+    size_t chunkSize_;
+    size_t position_{};
+    size_t written_{};
+};
+
+} // Bench
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.h"
+#include "serialport.h"
+#include "wakesimulator.h"
+
+#include <algorithm>
+
+namespace Bench {
+
+namespace {
+
+constexpr size_t SAMPLES = 10000;
+constexpr uint32_t BAUD_RATE = 115200;
+constexpr uint8_t PAYLOAD_SIZES[] = {0, 16, 128};
+
+double Percentile(const std::vector<double>& sorted, double p)
+{
+    auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+} // namespace
+
+// C_ECHO over a pseudo-terminal to the simulator with zero response latency,
+// the result is the cost of the library and the tty layer without the wire time
+void RunRoundTrip(Reporter& reporter)
+{
+    using Clock = std::chrono::steady_clock;
+    Wk::Simulator simulator;
+    simulator.AddNode(1, {});
+    simulator.Start();
+    SerialPort port{simulator.GetPortPath(), BAUD_RATE};
+    Wk::Wake wake{port};
+    if(!wake.OpenConnection()) {
+        std::cerr << "Round trip: unable to open " << simulator.GetPortPath() << '\n';
+        return;
+    }
+    for(auto size : PAYLOAD_SIZES) {
+        std::vector<double> samples;
+        samples.reserve(SAMPLES);
+        size_t failures{};
+        for(size_t i{}; i < SAMPLES; ++i) {
+            Wk::Packet_t packet{1, Wk::C_ECHO, {}};
+            packet.n = size;
+            auto begin = Clock::now();
+            if(!wake.Request(packet)) {
+                ++failures;
+                continue;
+            }
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+        }
+        auto param = "n=" + std::to_string(size);
+        if(samples.empty()) {
+            reporter.Add("Round trip failures", param, static_cast<double>(failures), "requests");
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        reporter.Add("Round trip p50", param, Percentile(samples, 0.5), "us");
+        reporter.Add("Round trip p99", param, Percentile(samples, 0.99), "us");
+        reporter.Add("Round trip p999", param, Percentile(samples, 0.999), "us");
+        reporter.Add("Round trip failures", param, static_cast<double>(failures), "requests");
+    }
+    simulator.Stop();
+}
+
+} // Bench
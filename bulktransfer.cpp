@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bulktransfer.h"
+#include "crc.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+namespace Wk {
+
+namespace {
+
+constexpr size_t DATA_HEADER_SIZE = 6;
+constexpr size_t REPLY_BUF_SIZE = 16;
+
+constexpr size_t GetStuffedSize(uint8_t value)
+{
+    return value == FEND || value == FESC ? 2 : 1;
+}
+
+void PutLe(uint8_t* buf, uint32_t value, size_t size)
+{
+    for(size_t i{}; i < size; ++i) {
+        buf[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+uint16_t GetLe16(const uint8_t* buf)
+{
+    return static_cast<uint16_t>(buf[0] | buf[1] << 8);
+}
+
+size_t MakeDataHeader(uint8_t* buf, size_t index, const BulkChunk& chunk)
+{
+    PutLe(buf, static_cast<uint32_t>(index), 2);
+    PutLe(buf + 2, chunk.offset, 4);
+    return DATA_HEADER_SIZE;
+}
+
+// Control request with retries, the reply starts with the error code. A reply rejected by accept,
+// like a late answer to the previous attempt, counts as a lost one.
+// Returns false if the node stays silent, err holds its error code otherwise.
+template<typename Accept>
+bool Exchange(Wake& wake,
+              const PacketView& request,
+              std::span<uint8_t> storage,
+              MutablePacketView& reply,
+              const BulkOptions& options,
+              uint8_t& err,
+              Accept accept)
+{
+    for(uint32_t attempt{}; attempt <= options.retries; ++attempt) {
+        reply.payload = storage;
+        auto result = options.timeout ? wake.Request(request, reply, options.timeout) : wake.Request(request, reply);
+        if(result && reply.cmd == request.cmd && !reply.payload.empty() && accept(reply.payload)) {
+            err = reply.payload[0];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Exchange(Wake& wake,
+              const PacketView& request,
+              std::span<uint8_t> storage,
+              MutablePacketView& reply,
+              const BulkOptions& options,
+              uint8_t& err)
+{
+    return Exchange(wake, request, storage, reply, options, err, [](std::span<const uint8_t>) { return true; });
+}
+
+} // namespace
+
+std::vector<BulkChunk> PlanChunks(uint8_t addr, std::span<const uint8_t> image, size_t maxPayload, size_t maxWireSize)
+{
+    if(image.size() > UINT32_MAX) {
+        throw std::invalid_argument("PlanChunks: image is larger than 4 GiB");
+    }
+    maxPayload = std::min<size_t>(maxPayload, UINT8_MAX);
+    // FEND, address, command, worst case length and CRC
+    const size_t frameOverhead = 1 + (addr ? GetStuffedSize(addr | 0x80) : 0) + GetStuffedSize(C_BULK_DATA) + 2 + 2;
+    std::vector<BulkChunk> chunks;
+    size_t offset{};
+    while(offset < image.size()) {
+        BulkChunk chunk{static_cast<uint32_t>(offset), 0};
+        uint8_t header[DATA_HEADER_SIZE];
+        MakeDataHeader(header, chunks.size(), chunk);
+        auto wireSize = frameOverhead;
+        for(auto value : header) {
+            wireSize += GetStuffedSize(value);
+        }
+        auto payload = DATA_HEADER_SIZE;
+        while(offset < image.size() && payload < maxPayload) {
+            auto next = wireSize + GetStuffedSize(image[offset]);
+            if(next > maxWireSize) {
+                break;
+            }
+            wireSize = next;
+            ++payload;
+            ++offset;
+            ++chunk.size;
+        }
+        if(!chunk.size) {
+            throw std::invalid_argument("PlanChunks: no room for data in a frame");
+        }
+        chunks.push_back(chunk);
+    }
+    if(chunks.size() > UINT16_MAX) {
+        throw std::invalid_argument("PlanChunks: image takes more than 65535 chunks");
+    }
+    return chunks;
+}
+
+BulkReport SendImage(Wake& wake, uint8_t addr, std::span<const uint8_t> image, const BulkOptions& options)
+{
+    if(IsNoReplyAddress(addr)) {
+        throw std::invalid_argument("SendImage: node address expected");
+    }
+    if(!options.ackEach && (!options.window || options.window > BulkOptions::MAX_WINDOW)) {
+        throw std::invalid_argument("SendImage: window is out of range");
+    }
+    auto chunks = PlanChunks(addr, image, options.maxPayload, options.maxWireSize);
+    BulkReport report;
+    report.chunks = chunks.size();
+    std::optional<Utils::ProgressBar> bar;
+    if(options.progress) {
+        bar.emplace(image.size(), "bytes");
+        bar->Update(0);
+    }
+
+    uint8_t replyBuf[REPLY_BUF_SIZE];
+    MutablePacketView reply{0, 0, replyBuf};
+    uint8_t err{};
+
+    uint8_t begin[7];
+    PutLe(begin, static_cast<uint32_t>(image.size()), 4);
+    PutLe(begin + 4, static_cast<uint32_t>(chunks.size()), 2);
+    begin[6] = options.ackEach ? BULK_ACK_EACH : 0;
+    if(!Exchange(wake, PacketView{addr, C_BULK_BEGIN, begin}, replyBuf, reply, options, err)) {
+        report.status = BulkStatus::NoReply;
+        return report;
+    }
+    if(err != ERR_NO) {
+        report.status = BulkStatus::Rejected;
+        return report;
+    }
+
+    uint8_t frame[UINT8_MAX];
+    auto makeData = [&](size_t index) {
+        auto& chunk = chunks[index];
+        auto size = MakeDataHeader(frame, index, chunk);
+        std::copy_n(image.data() + chunk.offset, chunk.size, frame + size);
+        return PacketView{addr, C_BULK_DATA, std::span<const uint8_t>(frame, size + chunk.size)};
+    };
+    size_t done{};
+
+    if(options.ackEach) {
+        for(size_t index{}; index < chunks.size(); ++index) {
+            auto data = makeData(index);
+            bool acked{};
+            for(uint32_t attempt{}; attempt <= options.retries && !acked; ++attempt) {
+                if(attempt) {
+                    ++report.retransmits;
+                }
+                reply.payload = replyBuf;
+                auto result = options.timeout ? wake.Request(data, reply, options.timeout) : wake.Request(data, reply);
+                acked = result && reply.payload.size() >= 3 && reply.payload[0] == ERR_NO &&
+                        GetLe16(&reply.payload[1]) == index;
+            }
+            if(!acked) {
+                report.status = BulkStatus::Incomplete;
+                return report;
+            }
+            done += chunks[index].size;
+            if(bar) {
+                bar->Update(done);
+            }
+        }
+    }
+    else {
+        std::vector<bool> acked(chunks.size());
+        std::vector<uint32_t> sends(chunks.size());
+        size_t base{};
+        while(base < chunks.size()) {
+            auto end = std::min(base + options.window, chunks.size());
+            for(auto index = base; index < end; ++index) {
+                if(acked[index]) {
+                    continue;
+                }
+                if(sends[index] > options.retries) {
+                    report.status = BulkStatus::Incomplete;
+                    return report;
+                }
+                if(sends[index]++) {
+                    ++report.retransmits;
+                }
+                if(!wake.Send(makeData(index))) {
+                    report.status = BulkStatus::TxError;
+                    return report;
+                }
+            }
+            // the reply timeout starts once the burst has left
+            wake.Flush();
+            uint8_t status[3];
+            PutLe(status, static_cast<uint32_t>(base), 2);
+            status[2] = static_cast<uint8_t>(end - base);
+            ++report.statusRequests;
+            auto bitmapSize = (end - base + 7) / 8;
+            auto accept = [&](std::span<const uint8_t> payload) {
+                return payload[0] != ERR_NO || (payload.size() >= 3 + bitmapSize && GetLe16(&payload[1]) == base);
+            };
+            if(!Exchange(wake, PacketView{addr, C_BULK_STATUS, status}, replyBuf, reply, options, err, accept)) {
+                report.status = BulkStatus::NoReply;
+                return report;
+            }
+            if(err != ERR_NO) {
+                report.status = BulkStatus::Rejected;
+                return report;
+            }
+            auto bitmap = &reply.payload[3];
+            for(auto index = base; index < end; ++index) {
+                auto bit = index - base;
+                if(!acked[index] && (bitmap[bit / 8] >> (bit % 8) & 1)) {
+                    acked[index] = true;
+                    done += chunks[index].size;
+                }
+            }
+            while(base < chunks.size() && acked[base]) {
+                ++base;
+            }
+            if(bar) {
+                bar->Update(done);
+            }
+        }
+    }
+
+    uint8_t end[4];
+    PutLe(end, Mcudrv::Crc::Crc32{}(image.data(), image.size()).GetResult(), 4);
+    if(!Exchange(wake, PacketView{addr, C_BULK_END, end}, replyBuf, reply, options, err)) {
+        report.status = BulkStatus::NoReply;
+    }
+    else if(err == ERR_PA) {
+        report.status = BulkStatus::CrcMismatch;
+    }
+    else if(err == ERR_RE) {
+        report.status = BulkStatus::Incomplete;
+    }
+    else if(err != ERR_NO) {
+        report.status = BulkStatus::Rejected;
+    }
+    return report;
+}
+
+} // Wk
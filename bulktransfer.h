@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wsp32.h"
+#include <span>
+#include <vector>
+
+namespace Wk {
+
+// Moves an image larger than one packet to a node. Multi-byte fields are little endian.
+//   C_BULK_BEGIN  [size:4][chunks:2][flags:1]       -> [err]
+//   C_BULK_DATA   [index:2][offset:4][data]         -> [err][index:2] with BULK_ACK_EACH, no reply otherwise
+//   C_BULK_STATUS [first:2][count:1]                -> [err][first:2][bitmap], bit i - chunk first + i is stored
+//   C_BULK_END    [crc32:4]                         -> [err], ERR_RE if chunks are missing, ERR_PA on CRC mismatch
+// In the windowed mode a window of chunks is sent back to back, one status request then tells
+// which of them to send again, so the link is busy with data instead of turnarounds.
+enum BulkFlags : uint8_t { BULK_ACK_EACH = 0x01 };
+
+struct BulkOptions
+{
+    static constexpr size_t MAX_WINDOW = 64; // status bitmap fits 8 bytes
+    size_t maxPayload = Packet_t::BUF_SIZE; // node receive buffer
+    size_t maxWireSize = 280;               // stuffed frame, node TX/RX buffer
+    size_t window = 16;                     // chunks between status requests, 1 - stop-and-wait
+    bool ackEach = false;                   // every chunk is acknowledged, the window is ignored
+    uint32_t retries = 5;                   // sends of the same chunk beyond the first one
+    uint32_t timeout = 0;                   // reply timeout in ms, 0 - adaptive
+    bool progress = false;                  // Utils::ProgressBar on stdout
+};
+
+struct BulkChunk
+{
+    uint32_t offset;
+    uint16_t size;
+};
+
+enum class BulkStatus {
+    Ok,
+    Rejected,   // the node refused the transfer
+    NoReply,
+    Incomplete, // chunks still missing after all the retries
+    CrcMismatch,
+    TxError     // a data frame couldn't be written to the port
+};
+
+struct BulkReport
+{
+    BulkStatus status{BulkStatus::Ok};
+    size_t chunks{};
+    size_t retransmits{};
+    size_t statusRequests{};
+};
+
+// Splits the image so that every data frame, its header and escapes included, fits maxWireSize
+// and carries no more than maxPayload bytes. The frame CRC isn't known in advance and is counted as escaped.
+std::vector<BulkChunk> PlanChunks(uint8_t addr, std::span<const uint8_t> image, size_t maxPayload, size_t maxWireSize);
+
+// Throws std::invalid_argument for a no-reply address, an image that doesn't fit the protocol limits
+// or options that leave no room for data
+BulkReport SendImage(Wake& wake, uint8_t addr, std::span<const uint8_t> image, const BulkOptions& options = {});
+
+} // Wk
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "busmonitor.h"
+#include <algorithm>
+
+namespace Wk {
+
+void BusMonitor::Start()
+{
+    if(!thread_.joinable()) {
+        running_ = true;
+        thread_ = std::thread{&BusMonitor::Run, this};
+    }
+}
+
+void BusMonitor::Stop()
+{
+    running_ = false;
+    if(thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+BusMonitor::Counters BusMonitor::GetCounters() const
+{
+    return {frames_.load(std::memory_order_relaxed), crcErrors_.load(std::memory_order_relaxed),
+            frameErrors_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed),
+            bytes_.load(std::memory_order_relaxed), oversized_.load(std::memory_order_relaxed)};
+}
+
+void BusMonitor::Run()
+{
+    FrameDecoder decoder;
+    MonitoredFrame frame;
+    uint8_t payload[UINT8_MAX];
+    port_.SetTimeout(READ_TIMEOUT_MS);
+    // one offset for the run, a wall clock step doesn't reorder the frames
+    auto wallOffset = std::chrono::system_clock::now().time_since_epoch() -
+                      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                        std::chrono::steady_clock::now().time_since_epoch());
+    while(running_.load(std::memory_order_relaxed)) {
+        auto received = port_.ReadSome(decoder.WritePtr(), static_cast<uint32_t>(decoder.WriteSpace()));
+        if(!received) {
+            // silence on the line ends any frame in progress
+            decoder.Resync();
+            continue;
+        }
+        auto timestamp = std::chrono::system_clock::time_point{
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::steady_clock::now().time_since_epoch()) +
+          wallOffset};
+        bytes_.fetch_add(received, std::memory_order_relaxed);
+        decoder.Commit(received);
+        auto& p = frame.packet;
+        for(;;) {
+            // the protocol allows N up to 255, more than a Packet_t holds
+            auto status = decoder.Decode(p.addr, p.cmd, p.n, payload, sizeof(payload));
+            if(status == FrameDecoder::Status::Incomplete) {
+                break;
+            }
+            if(status != FrameDecoder::Status::Ok && status != FrameDecoder::Status::CrcError) {
+                frameErrors_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if(p.n > Packet_t::BUF_SIZE) {
+                oversized_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            std::copy_n(payload, p.n, p.payload.begin());
+            frame.timestamp = timestamp;
+            frame.crcOk = status == FrameDecoder::Status::Ok;
+            frame.crc = decoder.GetRxCrc();
+            frames_.fetch_add(1, std::memory_order_relaxed);
+            if(!frame.crcOk) {
+                crcErrors_.fetch_add(1, std::memory_order_relaxed);
+            }
+            if(callback_) {
+                callback_(frame);
+            }
+            else if(!queue_.Push(frame)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+} // Wk
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "spscqueue.h"
+#include "wsp32.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace Wk {
+
+struct MonitoredFrame
+{
+    // When the block completing the frame was read. Wall clock, but steady within a run:
+    // it's the monotonic time shifted by the wall clock offset taken at Start()
+    std::chrono::system_clock::time_point timestamp;
+    bool crcOk;
+    uint8_t crc; // computed over the received bytes
+    Packet_t packet;
+};
+
+// Passive listener: decodes every frame on the wire, requests and replies alike, and never writes
+// to the port. Frames go to the callback on the monitor thread, or to a lock-free queue when no
+// callback is set. Frames with a wrong CRC are delivered with crcOk cleared. A frame carrying more
+// than Packet_t::BUF_SIZE bytes doesn't fit MonitoredFrame, it's only counted as oversized.
+class BusMonitor
+{
+public:
+    static constexpr size_t QUEUE_SIZE = 4096;
+    static constexpr uint32_t READ_TIMEOUT_MS = 100; // also the Stop() latency
+    using Callback = std::function<void(const MonitoredFrame&)>;
+    struct Counters
+    {
+        uint64_t frames;
+        uint64_t crcErrors;
+        uint64_t frameErrors; // stuffing, format, length and sync errors
+        uint64_t dropped;     // queue overflows
+        uint64_t bytes;
+        uint64_t oversized;   // valid frames with N over Packet_t::BUF_SIZE, decoded but not delivered
+    };
+
+    explicit BusMonitor(ISerialPort& port) : port_{port}
+    { }
+    BusMonitor(const BusMonitor&) = delete;
+    BusMonitor& operator=(const BusMonitor&) = delete;
+    ~BusMonitor()
+    {
+        Stop();
+    }
+    // Must be set before Start()
+    void SetCallback(Callback callback)
+    {
+        callback_ = std::move(callback);
+    }
+    void Start();
+    void Stop();
+    // Consumer side of the queue, for a single thread
+    bool Pop(MonitoredFrame& frame)
+    {
+        return queue_.Pop(frame);
+    }
+    Counters GetCounters() const;
+private:
+    ISerialPort& port_;
+    Callback callback_;
+    std::thread thread_;
+    std::atomic<bool> running_{};
+    Utils::SpscQueue<MonitoredFrame, QUEUE_SIZE> queue_;
+    std::atomic<uint64_t> frames_{}, crcErrors_{}, frameErrors_{}, dropped_{}, bytes_{}, oversized_{};
+
+    void Run();
+};
+
+} // Wk
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "capturedecoder.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define WAKE_X86_SIMD
+#endif
+
+namespace Wk {
+
+namespace {
+
+#ifdef WAKE_X86_SIMD
+__attribute__((target("sse2"))) size_t FindSymbolSse2(const uint8_t* data, size_t size)
+{
+    const auto fend = _mm_set1_epi8(static_cast<char>(FEND));
+    const auto fesc = _mm_set1_epi8(static_cast<char>(FESC));
+    size_t i{};
+    for(; i + 16 <= size; i += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, fend), _mm_cmpeq_epi8(v, fesc)));
+        if(mask) {
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+    return i + FindEscape(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) size_t FindSymbolAvx2(const uint8_t* data, size_t size)
+{
+    const auto fend = _mm256_set1_epi8(static_cast<char>(FEND));
+    const auto fesc = _mm256_set1_epi8(static_cast<char>(FESC));
+    size_t i{};
+    for(; i + 32 <= size; i += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        auto mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, fend), _mm256_cmpeq_epi8(v, fesc)));
+        if(mask) {
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+    return i + FindSymbolSse2(data + i, size - i);
+}
+#endif
+
+using FindFn = size_t (*)(const uint8_t*, size_t);
+
+FindFn SelectFind()
+{
+#ifdef WAKE_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return FindSymbolAvx2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        return FindSymbolSse2;
+    }
+#endif
+    return FindEscape;
+}
+
+} // namespace
+
+size_t FindSymbol(const uint8_t* data, size_t size)
+{
+    static const FindFn find = SelectFind();
+    return find(data, size);
+}
+
+bool CaptureDecoder::Next(FrameView& frame)
+{
+    while(position_ < size_) {
+        // frame start
+        auto fend = position_ + FindSymbol(data_ + position_, size_ - position_);
+        while(fend < size_ && data_[fend] != FEND) {
+            fend += 1 + FindSymbol(data_ + fend + 1, size_ - fend - 1);
+        }
+        skipped_ += fend - position_;
+        if(fend >= size_) {
+            position_ = size_;
+            return false;
+        }
+        // frame end, note the escapes on the way
+        auto end = fend + 1;
+        bool escaped{};
+        for(;;) {
+            end += FindSymbol(data_ + end, size_ - end);
+            if(end >= size_ || data_[end] == FEND) {
+                break;
+            }
+            escaped = true;
+            ++end;
+        }
+        position_ = end;
+        frame.offset = fend;
+        frame.size = end - fend;
+        const uint8_t* const wireBody = data_ + fend + 1;
+        const size_t wireSize = end - fend - 1;
+        const uint8_t* body = wireBody;
+        size_t bodySize = wireSize;
+        if(escaped) {
+            scratch_.resize(bodySize);
+            size_t j{};
+            for(size_t i{}; i < bodySize; ++i) {
+                auto run = FindEscape(body + i, bodySize - i);
+                memcpy(scratch_.data() + j, body + i, run);
+                j += run;
+                i += run;
+                // a broken escape ends the frame, it's still complete if the noise follows the CRC
+                if(i == bodySize || i + 1 == bodySize || (body[i + 1] != TFEND && body[i + 1] != TFESC)) {
+                    break;
+                }
+                scratch_[j++] = body[i + 1] == TFEND ? FEND : FESC;
+                ++i;
+            }
+            body = scratch_.data();
+            bodySize = j;
+        }
+        if(Parse(body, bodySize, frame)) {
+            // anything after the CRC byte is line noise before the next FEND, counted in wire bytes
+            auto used = static_cast<size_t>(frame.payload - body) + frame.n + 1;
+            size_t wireUsed{};
+            for(size_t k{}; k < used; ++k) {
+                wireUsed += wireBody[wireUsed] == FESC ? 2 : 1;
+            }
+            skipped_ += wireSize - wireUsed;
+            return true;
+        }
+        ++malformed_;
+    }
+    return false;
+}
+
+bool CaptureDecoder::Parse(const uint8_t* body, size_t size, FrameView& frame)
+{
+    size_t i{};
+    frame.addr = 0;
+    if(size && (body[0] & 0x80)) {
+        frame.addr = body[i++] & 0x7F;
+    }
+    if(i + 2 > size || (body[i] & 0x80)) {
+        return false;
+    }
+    frame.cmd = body[i++];
+    frame.n = body[i++];
+    if(i + frame.n + 1 > size) {
+        return false;
+    }
+    frame.payload = body + i;
+    frame.crc = body[i + frame.n];
+    Mcudrv::Crc::Crc8 crc(CRC_INIT);
+    crc(FEND)(body, i + frame.n + 1);
+    frame.crcOk = !crc.GetResult();
+    return true;
+}
+
+} // Wk
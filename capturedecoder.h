@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wakecodec.h"
+#include <vector>
+
+namespace Wk {
+
+// Position of the first FEND or FESC, size if there is none.
+// Uses AVX2 or SSE2 compares when the CPU has them, picked on the first call.
+size_t FindSymbol(const uint8_t* data, size_t size);
+
+struct FrameView
+{
+    size_t offset;          // FEND position in the capture
+    size_t size;            // wire size up to the next FEND or the end of the capture
+    const uint8_t* payload; // points into the capture when the frame has no escapes
+    uint8_t addr;           // 0 when the frame has no ADD byte
+    uint8_t cmd;
+    uint8_t n;
+    uint8_t crc;
+    bool crcOk;
+};
+
+// Pulls frames out of a raw byte capture (e.g. a memory-mapped file) without copying:
+// frames without escapes are parsed in place, others are unstuffed into an internal buffer,
+// which is valid until the next call. Fragments that are not frames are skipped and counted,
+// frames with a wrong CRC are returned with crcOk cleared.
+class CaptureDecoder
+{
+public:
+    CaptureDecoder(const uint8_t* data, size_t size) : data_{data}, size_{size}
+    { }
+    bool Next(FrameView& frame);
+    void Seek(size_t offset)
+    {
+        position_ = offset < size_ ? offset : size_;
+    }
+    size_t GetPosition() const
+    {
+        return position_;
+    }
+    // Wire bytes that didn't belong to any frame: before a FEND and after the CRC of a frame
+    size_t GetSkipped() const
+    {
+        return skipped_;
+    }
+    size_t GetMalformed() const
+    {
+        return malformed_;
+    }
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_{};
+    size_t skipped_{};
+    size_t malformed_{};
+    std::vector<uint8_t> scratch_;
+
+    bool Parse(const uint8_t* body, size_t size, FrameView& frame);
+};
+
+} // Wk
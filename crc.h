@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Mcudrv {
+namespace Crc {
+
+// Table driven computation, the default algorithm
+struct Lut
+{ };
+
+namespace Detail {
+
+template<unsigned Width>
+using Register = std::conditional_t<
+  Width <= 8,
+  uint8_t,
+  std::conditional_t<Width <= 16, uint16_t, std::conditional_t<Width <= 32, uint32_t, uint64_t>>>;
+
+constexpr uint64_t Reflect(uint64_t value, unsigned width)
+{
+    uint64_t result{};
+    for(unsigned i = 0; i < width; ++i) {
+        result = (result << 1) | ((value >> i) & 1);
+    }
+    return result;
+}
+
+// tables[k][x] - register after the byte x followed by k zero bytes
+template<typename Value, unsigned Width, uint64_t Poly, bool Ref>
+constexpr std::array<std::array<Value, 256>, 8> MakeTables()
+{
+    constexpr uint64_t mask = ~uint64_t{} >> (64 - Width);
+    constexpr uint64_t top = uint64_t{1} << (Width - 1);
+    std::array<std::array<Value, 256>, 8> tables{};
+    for(uint64_t x = 0; x < 256; ++x) {
+        uint64_t crc = Ref ? x : x << (Width - 8);
+        for(int bit = 0; bit < 8; ++bit) {
+            if constexpr(Ref) {
+                crc = crc & 1 ? (crc >> 1) ^ Reflect(Poly, Width) : crc >> 1;
+            }
+            else {
+                crc = (crc & top ? (crc << 1) ^ Poly : crc << 1) & mask;
+            }
+        }
+        tables[0][x] = static_cast<Value>(crc);
+    }
+    for(size_t k = 1; k < 8; ++k) {
+        for(size_t x = 0; x < 256; ++x) {
+            uint64_t crc = tables[k - 1][x];
+            if constexpr(Ref) {
+                crc = (crc >> 8) ^ tables[0][crc & 0xFF];
+            }
+            else {
+                crc = ((crc << 8) & mask) ^ tables[0][(crc >> (Width - 8)) & 0xFF];
+            }
+            tables[k][x] = static_cast<Value>(crc);
+        }
+    }
+    return tables;
+}
+
+} // Detail
+
+// Parameters follow the CRC catalogues (Rocksoft model): Poly in the normal MSB-first form,
+// InitValue and XorOut as seen from outside. Reflected algorithms keep the register reflected,
+// so the seed of the constructor is a raw register value.
+// Algo other than Lut evaluates a byte with Algo::Evaluate(register, byte).
+template<unsigned Width, uint64_t Poly, uint64_t InitValue, bool RefIn, bool RefOut, uint64_t XorOut, typename Algo = Lut>
+class Crc
+{
+    static_assert(8 <= Width && Width <= 64, "8 to 64 bit wide CRC");
+public:
+    using Value = Detail::Register<Width>;
+    // Block kernels, all of them give the same result
+    using Engine = Value (*)(Value crc, const uint8_t* buf, size_t len);
+    static constexpr Value MASK = static_cast<Value>(~uint64_t{} >> (64 - Width));
+    static constexpr Value SEED = static_cast<Value>(RefIn ? Detail::Reflect(InitValue, Width) : InitValue);
+    // Buffers shorter than this don't pay back the dispatch
+    static constexpr size_t SHORT_BLOCK_SIZE = 16;
+private:
+    typedef Crc Self;
+    static constexpr auto tables = Detail::MakeTables<Value, Width, Poly, RefIn>();
+    static inline std::atomic<Engine> selectedEngine_{};
+    Value crc_;
+public:
+    static constexpr Value UpdateByte(Value crc, uint8_t byte)
+    {
+        if constexpr(RefIn) {
+            return static_cast<Value>((crc >> 8) ^ tables[0][static_cast<uint8_t>(crc ^ byte)]);
+        }
+        else {
+            return static_cast<Value>(((crc << 8) & MASK) ^ tables[0][static_cast<uint8_t>((crc >> (Width - 8)) ^ byte)]);
+        }
+    }
+    static constexpr Value UpdateBytewise(Value crc, const uint8_t* buf, size_t len)
+    {
+        for(size_t i = 0; i < len; ++i) {
+            crc = UpdateByte(crc, buf[i]);
+        }
+        return crc;
+    }
+    // Slicing-by-N: one word of input per step, N independent table lookups
+    template<size_t N>
+    static Value UpdateSlicing(Value crc, const uint8_t* buf, size_t len)
+    {
+        static_assert(N == 4 || N == 8);
+        for(; len >= N; len -= N, buf += N) {
+            crc = SliceStep(crc, buf, std::make_index_sequence<N>{});
+        }
+        return UpdateBytewise(crc, buf, len);
+    }
+    static Value UpdateSlicing4(Value crc, const uint8_t* buf, size_t len)
+    {
+        return UpdateSlicing<4>(crc, buf, len);
+    }
+    static Value UpdateSlicing8(Value crc, const uint8_t* buf, size_t len)
+    {
+        return UpdateSlicing<8>(crc, buf, len);
+    }
+    // The fastest kernel for this CPU, measured once on the first call
+    static Engine GetEngine()
+    {
+        auto engine = selectedEngine_.load(std::memory_order_acquire);
+        if(!engine) {
+            static const Engine measured = SelectEngine();
+            Engine expected{};
+            selectedEngine_.compare_exchange_strong(expected, measured, std::memory_order_acq_rel);
+            engine = selectedEngine_.load(std::memory_order_acquire);
+        }
+        return engine;
+    }
+    // Overrides the automatic selection
+    static void SetEngine(Engine engine)
+    {
+        selectedEngine_.store(engine, std::memory_order_release);
+    }
+
+    constexpr Crc(Value seed = SEED) : crc_(seed)
+    { }
+    constexpr void Init(Value seed)
+    {
+        crc_ = seed;
+    }
+    constexpr Self& Reset(Value seed = SEED)
+    {
+        crc_ = seed;
+        return *this;
+    }
+    constexpr Self& operator()(uint8_t value)
+    {
+        if constexpr(std::is_same_v<Algo, Lut>) {
+            crc_ = UpdateByte(crc_, value);
+        }
+        else {
+            Algo::Evaluate(crc_, value);
+        }
+        return *this;
+    }
+    Self& operator()(const uint8_t* buf, size_t len)
+    {
+        if constexpr(std::is_same_v<Algo, Lut>) {
+            crc_ = len < SHORT_BLOCK_SIZE ? UpdateBytewise(crc_, buf, len) : GetEngine()(crc_, buf, len);
+        }
+        else {
+            for(size_t i = 0; i < len; ++i) {
+                Algo::Evaluate(crc_, buf[i]);
+            }
+        }
+        return *this;
+    }
+    // Register value, to continue in another object
+    constexpr Value GetRegister() const
+    {
+        return crc_;
+    }
+    constexpr Value GetResult() const
+    {
+        uint64_t value = crc_;
+        if constexpr(RefIn != RefOut) {
+            value = Detail::Reflect(value, Width);
+        }
+        return static_cast<Value>(value ^ XorOut);
+    }
+private:
+    template<size_t... I>
+    static Value SliceStep(Value crc, const uint8_t* buf, std::index_sequence<I...>)
+    {
+        constexpr size_t N = sizeof...(I);
+        // the register bits that meet the N input bytes and the ones that are just shifted
+        uint64_t c = crc, head, rest{};
+        if constexpr(RefIn) {
+            head = c;
+            if constexpr(Width > 8 * N) {
+                rest = c >> (8 * N);
+            }
+            return static_cast<Value>(
+              rest ^ (tables[N - 1 - I][static_cast<uint8_t>(buf[I] ^ (head >> (8 * I)))] ^ ...));
+        }
+        else {
+            if constexpr(Width > 8 * N) {
+                head = c >> (Width - 8 * N);
+                rest = (c << (8 * N)) & MASK;
+            }
+            else {
+                head = c << (8 * N - Width);
+            }
+            return static_cast<Value>(
+              rest ^ (tables[N - 1 - I][static_cast<uint8_t>(buf[I] ^ (head >> (8 * (N - 1 - I))))] ^ ...));
+        }
+    }
+    static Engine SelectEngine()
+    {
+        constexpr size_t SAMPLE_SIZE = 4096;
+        constexpr int ROUNDS = 8;
+        std::vector<uint8_t> sample(SAMPLE_SIZE);
+        for(size_t i{}; i < SAMPLE_SIZE; ++i) {
+            sample[i] = static_cast<uint8_t>(i * 131 + 7);
+        }
+        Engine best{};
+        auto bestTime = std::chrono::nanoseconds::max();
+        Value sink{};
+        for(auto engine : {Engine{UpdateBytewise}, Engine{UpdateSlicing4}, Engine{UpdateSlicing8}}) {
+            auto begin = std::chrono::steady_clock::now();
+            for(int i = 0; i < ROUNDS; ++i) {
+                sink = engine(sink, sample.data(), sample.size());
+            }
+            auto time = std::chrono::steady_clock::now() - begin;
+            if(time < bestTime) {
+                bestTime = time;
+                best = engine;
+            }
+        }
+        // keeps the measured loops alive
+        static volatile Value keep;
+        keep = keep ^ sink;
+        return best;
+    }
+};
+
+// CRC of "123456789", the check value listed in the catalogues
+template<typename CrcType>
+constexpr typename CrcType::Value GetCheckValue()
+{
+    CrcType crc;
+    for(uint8_t c = '1'; c <= '9'; ++c) {
+        crc(c);
+    }
+    return crc.GetResult();
+}
+
+using Crc16Ccitt = Crc<16, 0x1021, 0xFFFF, false, false, 0x0000>;  // CRC-16/CCITT-FALSE
+using Crc16Modbus = Crc<16, 0x8005, 0xFFFF, true, true, 0x0000>;   // CRC-16/MODBUS
+using Crc32 = Crc<32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF>;  // zlib, Ethernet
+using Crc32C = Crc<32, 0x1EDC6F41, 0xFFFFFFFF, true, true, 0xFFFFFFFF>; // Castagnoli
+using Crc64Xz = Crc<64, 0x42F0E1EBA9EA3693, ~uint64_t{}, true, true, ~uint64_t{}>;
+
+static_assert(GetCheckValue<Crc16Ccitt>() == 0x29B1);
+static_assert(GetCheckValue<Crc16Modbus>() == 0x4B37);
+static_assert(GetCheckValue<Crc32>() == 0xCBF43926);
+static_assert(GetCheckValue<Crc32C>() == 0xE3069283);
+static_assert(GetCheckValue<Crc64Xz>() == 0x995DC9BBDF1939FA);
+
+} // Crc
+} // Mcudrv
@@ -24,6 +24,8 @@
 #ifndef CRC_H
 #define CRC_H
 
+#include "crc.h"
+#include "stddef.h"
 #include "stdint.h"
 
 #undef FORCEINLINE
@@ -37,48 +39,17 @@ namespace Mcudrv {
 namespace Crc {
 
 // Maxim-Dallas computation (X8 + X5 + X4 + 1)
-class Crc8
-{
-private:
-    typedef Crc8 Self;
-    static const uint8_t table[256];
-    uint8_t crc_;
-public:
-    Crc8(uint8_t init = 0) : crc_(init)
-    { }
-    void Init(uint8_t init)
-    {
-        crc_ = init;
-    }
-    Self& Reset(uint8_t init = 0)
-    {
-        crc_ = init;
-        return *this;
-    }
-    Self& operator()(uint8_t value)
-    {
-        crc_ = table[crc_ ^ value];
-        return *this;
-    }
-    Self& operator()(const uint8_t* buf, uint8_t len)
-    {
-        for(uint8_t i = 0; i < len; ++i) {
-            crc_ = table[crc_ ^ buf[i]];
-        }
-        return *this;
-    }
-    uint8_t GetResult()
-    {
-        return crc_;
-    }
-};
+using Crc8 = Crc<8, 0x31, 0x00, true, true, 0x00>;
+
+static_assert(Crc8{}(0x01).GetResult() == 94, "Maxim CRC-8 table");
+static_assert(GetCheckValue<Crc8>() == 0xA1);
 
 namespace NoLUT {
 
 struct Crc8_Algo1
 {
     FORCEINLINE
-    static void Evaluate(uint8_t& crc, uint8_t inByte)
+    static constexpr void Evaluate(uint8_t& crc, uint8_t inByte)
     {
         for(uint8_t i = 8; i; --i) {
             uint8_t mix = (crc ^ inByte) & 0x01;
@@ -93,7 +64,7 @@ struct Crc8_Algo1
 struct Crc8_Algo2
 {
     FORCEINLINE
-    static void Evaluate(uint8_t& crc, uint8_t inByte)
+    static constexpr void Evaluate(uint8_t& crc, uint8_t inByte)
     {
         for(char i = 0; i < 8; inByte = inByte >> 1, ++i)
             if((inByte ^ crc) & 1) {
@@ -105,41 +76,7 @@ struct Crc8_Algo2
 };
 
 template<typename Algo = Crc8_Algo1>
-class Crc8
-{
-private:
-    typedef Crc8 Self;
-    uint8_t crc_;
-public:
-    //  Crc8(uint8_t init = 0) : crc_(init)
-    //	{	}
-    void Init(uint8_t init)
-    {
-        crc_ = init;
-    }
-    Self& Reset(uint8_t init = 0)
-    {
-        crc_ = init;
-        return *this;
-    }
-    Self& operator()(uint8_t value)
-    {
-        Algo::Evaluate(crc_, value);
-        return *this;
-    }
-    Self& operator()(const uint8_t* buf, uint8_t len)
-    {
-        for(uint8_t i = 0; i < len; ++i) {
-            operator()(buf[i]);
-            //        Algo::Evaluate(crc_, buf[i]);
-        }
-        return *this;
-    }
-    uint8_t GetResult()
-    {
-        return crc_;
-    }
-};
+using Crc8 = Crc<8, 0x31, 0x00, true, true, 0x00, Algo>;
 
 } // NoLUT
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "discovery.h"
+#include <future>
+
+namespace Wk {
+
+namespace {
+
+constexpr size_t BITS_PER_BYTE = 10; // 8N1
+constexpr size_t PROBE_FRAME_SIZE = 5; // FEND, ADD, CMD, N, CRC
+
+// Time on the wire in us, every byte but FEND may be stuffed
+uint32_t GetWireTime(uint32_t baud, size_t frameSize)
+{
+    auto bytes = 1 + 2 * (frameSize - 1);
+    return static_cast<uint32_t>((bytes * BITS_PER_BYTE * 1000000 + baud - 1) / baud);
+}
+
+} // namespace
+
+uint32_t GetReplyTimeout(uint32_t baud, size_t requestSize, uint32_t turnaroundUs, uint32_t adapterLatencyUs)
+{
+    // the request is still in the UART when the write returns, one ms covers the scheduling slack
+    auto us = GetWireTime(baud, requestSize) + turnaroundUs + GetWireTime(baud, 1) + adapterLatencyUs;
+    return (us + 999) / 1000 + 1;
+}
+
+BusTopology ScanBus(Wake& wake, const ScanOptions& options)
+{
+    BusTopology topology;
+    auto baud = wake.GetBaudRate();
+    auto savedInterByteTimeout = wake.GetInterByteTimeout();
+    uint32_t timeout = 50; // baud rate unknown
+    if(baud) {
+        timeout = GetReplyTimeout(baud, PROBE_FRAME_SIZE, options.turnaroundUs, options.adapterLatencyUs);
+        // the adapter may split the reply over two transfers
+        wake.SetInterByteTimeout((GetWireTime(baud, PROBE_FRAME_SIZE) + options.adapterLatencyUs + 999) / 1000 + 1);
+    }
+    for(size_t addr = options.firstAddr; addr <= options.lastAddr; ++addr) {
+        if(IsNoReplyAddress(static_cast<uint8_t>(addr))) {
+            continue;
+        }
+        bool found{}, suspect{};
+        for(uint32_t attempt{}; attempt <= options.retries; ++attempt) {
+            Packet_t packet{static_cast<uint8_t>(addr), C_ECHO, {}};
+            found = wake.Request(packet, timeout);
+            auto status = wake.GetLastStatus();
+            suspect = status == RequestStatus::CrcError || status == RequestStatus::FrameError;
+            if(found || !suspect) {
+                break;
+            }
+            ++topology.retries;
+        }
+        if(found) {
+            topology.nodes[static_cast<uint8_t>(addr)];
+        }
+        else if(suspect) {
+            topology.suspects.push_back(static_cast<uint8_t>(addr));
+        }
+    }
+    wake.SetInterByteTimeout(savedInterByteTimeout);
+    if(options.readInfo) {
+        for(auto& [addr, info] : topology.nodes) {
+            info = wake.GetInfo(addr);
+        }
+    }
+    return topology;
+}
+
+Topology ScanBuses(const std::map<std::string, Wake*>& buses, const ScanOptions& options)
+{
+    std::map<std::string, std::future<BusTopology>> scans;
+    for(const auto& [name, wake] : buses) {
+        scans[name] = std::async(std::launch::async, ScanBus, std::ref(*wake), std::cref(options));
+    }
+    Topology topology;
+    for(auto& [name, scan] : scans) {
+        topology[name] = scan.get();
+    }
+    return topology;
+}
+
+} // Wk
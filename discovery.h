@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wsp32.h"
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Wk {
+
+struct ScanOptions
+{
+    uint8_t firstAddr = 1;
+    uint8_t lastAddr = 127;
+    uint32_t turnaroundUs = 1000; // node processing time before the reply
+    // USB adapters hold received bytes up to their latency timer, 16 ms by default on FTDI,
+    // 0 suits native UARTs and ports in the low latency profile
+    uint32_t adapterLatencyUs = 16000;
+    uint32_t retries = 2;         // repeats after a CRC or framing error, a silent address is not asked again
+    bool readInfo = false;        // GetInfo for each node found
+};
+
+struct BusTopology
+{
+    std::map<uint8_t, std::optional<DeviceInfo>> nodes;
+    std::vector<uint8_t> suspects; // answered with corrupted frames only
+    size_t retries{};
+};
+
+using Topology = std::map<std::string, BusTopology>;
+
+// Least safe wait for the first reply byte in ms, requestSize is the unstuffed frame length
+uint32_t GetReplyTimeout(uint32_t baud, size_t requestSize, uint32_t turnaroundUs, uint32_t adapterLatencyUs = 0);
+
+// Probes each node address with an empty echo
+BusTopology ScanBus(Wake& wake, const ScanOptions& options = {});
+// Scans the buses at the same time, one thread per bus
+Topology ScanBuses(const std::map<std::string, Wake*>& buses, const ScanOptions& options = {});
+
+} // Wk
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "framebatch.h"
+
+namespace Wk {
+
+bool FrameBatch::Add(uint8_t addr, uint8_t cmd, uint8_t n, const uint8_t* data)
+{
+    if(!IsNoReplyAddress(addr)) {
+        return false;
+    }
+    auto size = buf_.size();
+    buf_.resize(size + MAX_FRAME_SIZE);
+    uint8_t crc;
+    buf_.resize(size + EncodeFrame(addr, cmd, n, data, buf_.data() + size, crc));
+    frameEnds_.push_back(buf_.size());
+    changesNodes_ = changesNodes_ || cmd == C_SETNODEADDRESS || cmd == C_SAVESETTINGS || cmd == C_REBOOT;
+    return true;
+}
+
+bool FrameBatch::Send(ISerialPort& port, Pacing pacing, uint32_t gapUs) const
+{
+    if(buf_.empty()) {
+        return true;
+    }
+    auto fillSize = pacing == Pacing::Gap ? GetFillSize(gapUs, port.GetBaudRate()) : 0;
+    bool result;
+    if(!fillSize) {
+        result = port.WriteData(buf_.data(), static_cast<uint32_t>(buf_.size()));
+    }
+    else {
+        std::vector<uint8_t> fill(fillSize, FEND);
+        std::vector<IoSegment> segments;
+        segments.reserve(frameEnds_.size() * 2);
+        size_t begin{};
+        for(auto end : frameEnds_) {
+            if(begin) {
+                segments.push_back({fill.data(), static_cast<uint32_t>(fill.size())});
+            }
+            segments.push_back({buf_.data() + begin, static_cast<uint32_t>(end - begin)});
+            begin = end;
+        }
+        result = port.WriteDataV(segments.data(), segments.size());
+    }
+    if(result && pacing == Pacing::Drain) {
+        result = port.Flush();
+    }
+    return result;
+}
+
+} // Wk
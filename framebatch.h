@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wsp32.h"
+#include <vector>
+
+namespace Wk {
+
+// Frames to broadcast and group addresses get no reply, so any number of them can be encoded
+// back to back and go to the port in a single write.
+class FrameBatch
+{
+public:
+    enum class Pacing {
+        None,  // frames follow each other immediately
+        Drain, // Send() returns when the last byte has left the transmitter
+        Gap    // idle time between frames, filled with FEND symbols (every FEND restarts the receiver)
+    };
+
+    explicit FrameBatch(size_t reserve = 1024)
+    {
+        buf_.reserve(reserve);
+    }
+    // Returns false for addresses that expect a reply
+    bool Add(uint8_t addr, uint8_t cmd, uint8_t n, const uint8_t* data);
+    bool Add(const Packet_t& packet)
+    {
+        return Add(packet.addr, packet.cmd, packet.n, packet.payload.data());
+    }
+    // Returns false for more than 255 data bytes as well
+    bool Add(uint8_t addr, uint8_t cmd, std::initializer_list<uint8_t> data)
+    {
+        if(data.size() > UINT8_MAX) {
+            return false;
+        }
+        return Add(addr, cmd, static_cast<uint8_t>(data.size()), data.begin());
+    }
+    void Clear()
+    {
+        buf_.clear();
+        frameEnds_.clear();
+        changesNodes_ = false;
+    }
+    size_t GetFrameCount() const
+    {
+        return frameEnds_.size();
+    }
+    // Wire image size without pacing
+    size_t GetSize() const
+    {
+        return buf_.size();
+    }
+    // FEND symbols needed to keep the line busy for gapUs at the given baud rate (10 bits per symbol)
+    static size_t GetFillSize(uint32_t gapUs, uint32_t baudRate)
+    {
+        return (static_cast<uint64_t>(gapUs) * baudRate + 10 * 1000000ULL - 1) / (10 * 1000000ULL);
+    }
+    // One write for the whole batch. The gap is derived from the port baud rate, Pacing::Gap
+    // turns into Pacing::None when the port doesn't report it.
+    bool Send(ISerialPort& port, Pacing pacing = Pacing::None, uint32_t gapUs = 0) const;
+    // The same through the port of wake, its device info cache is dropped if the batch changes the nodes
+    bool Send(Wake& wake, Pacing pacing = Pacing::None, uint32_t gapUs = 0) const
+    {
+        if(changesNodes_) {
+            wake.InvalidateInfo();
+        }
+        return Send(wake.GetPort(), pacing, gapUs);
+    }
+private:
+    std::vector<uint8_t> buf_;
+    std::vector<size_t> frameEnds_;
+    bool changesNodes_{}; // SETNODEADDRESS, SAVESETTINGS or REBOOT added
+};
+
+} // Wk
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "framelog.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+namespace Wk {
+namespace FrameLog {
+
+namespace {
+
+template<typename T>
+void Put(std::vector<uint8_t>& buf, const T& value)
+{
+    auto bytes = reinterpret_cast<const uint8_t*>(&value);
+    buf.insert(buf.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+T Load(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+bool WriteOut(FILE* file, std::vector<uint8_t>& buf)
+{
+    bool result = buf.empty() || fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+    buf.clear();
+    return result;
+}
+
+} // namespace
+
+bool Writer::Open(const std::string& path)
+{
+    Close();
+    log_ = fopen(path.c_str(), "wb");
+    index_ = fopen((path + ".idx").c_str(), "w+b");
+    if(!log_ || !index_) {
+        Close();
+        return false;
+    }
+    // own buffers, stdio doesn't add another copy
+    setvbuf(log_, nullptr, _IONBF, 0);
+    setvbuf(index_, nullptr, _IONBF, 0);
+    logBuf_.reserve(BUFFER_SIZE);
+    indexBuf_.reserve(BUFFER_SIZE);
+    LogHeader logHeader{};
+    memcpy(logHeader.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+    Put(logBuf_, logHeader);
+    logOffset_ = sizeof(LogHeader);
+    IndexHeader indexHeader{};
+    memcpy(indexHeader.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    Put(indexBuf_, indexHeader);
+    count_ = 0;
+    lastTimestamp_ = 0;
+    ok_ = true;
+    return true;
+}
+
+bool Writer::Append(uint64_t timestamp, uint16_t bus, const Packet_t& packet, bool crcOk, Direction direction)
+{
+    if(!log_ || !ok_ || packet.n > packet.payload.size() || count_ >= MAX_RECORDS) {
+        return false;
+    }
+    // the time search relies on the order
+    timestamp = std::max(timestamp, lastTimestamp_);
+    lastTimestamp_ = timestamp;
+    RecordHeader header{timestamp,
+                        bus,
+                        packet.addr,
+                        packet.cmd,
+                        packet.n,
+                        static_cast<uint8_t>((crcOk ? FLAG_CRC_OK : 0) | (direction == Direction::Tx ? FLAG_TX : 0)),
+                        0};
+    if(logBuf_.size() + sizeof(header) + packet.n > BUFFER_SIZE) {
+        ok_ = WriteOut(log_, logBuf_);
+    }
+    if(indexBuf_.size() + sizeof(IndexEntry) > BUFFER_SIZE) {
+        ok_ = ok_ && WriteOut(index_, indexBuf_);
+    }
+    Put(logBuf_, header);
+    logBuf_.insert(logBuf_.end(), packet.payload.begin(), packet.payload.begin() + packet.n);
+    Put(indexBuf_, IndexEntry{timestamp, logOffset_, bus, packet.addr, packet.cmd, 0});
+    addrs_.push_back(packet.addr & 0x7F);
+    cmds_.push_back(packet.cmd);
+    logOffset_ += sizeof(header) + packet.n;
+    ++count_;
+    return ok_;
+}
+
+bool Writer::Flush()
+{
+    if(!log_) {
+        return false;
+    }
+    ok_ = ok_ && WriteOut(log_, logBuf_) && WriteOut(index_, indexBuf_) && !fflush(log_) && !fflush(index_);
+    return ok_;
+}
+
+bool Writer::WriteSection(const std::vector<uint8_t>& keys, size_t keyCount, uint64_t& sectionOffset)
+{
+    // counting sort of the record numbers by key, stable, so each group stays in time order
+    std::vector<uint64_t> starts(keyCount + 1);
+    for(auto key : keys) {
+        ++starts[key + 1];
+    }
+    for(size_t i = 1; i <= keyCount; ++i) {
+        starts[i] += starts[i - 1];
+    }
+    std::vector<uint32_t> numbers(keys.size());
+    auto fill = starts;
+    for(size_t i{}; i < keys.size(); ++i) {
+        numbers[fill[keys[i]]++] = static_cast<uint32_t>(i);
+    }
+    sectionOffset = static_cast<uint64_t>(ftell(index_));
+    return fwrite(starts.data(), sizeof(uint64_t), starts.size(), index_) == starts.size() &&
+           fwrite(numbers.data(), sizeof(uint32_t), numbers.size(), index_) == numbers.size();
+}
+
+bool Writer::Close()
+{
+    if(!log_ && !index_) {
+        return false;
+    }
+    bool result = false;
+    if(log_ && index_ && Flush()) {
+        IndexHeader header{};
+        memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.count = count_;
+        result = !fseek(index_, 0, SEEK_END) && WriteSection(addrs_, ADDR_KEYS, header.addrSection) &&
+                 WriteSection(cmds_, CMD_KEYS, header.cmdSection) && !fseek(index_, 0, SEEK_SET) &&
+                 fwrite(&header, sizeof(header), 1, index_) == 1;
+    }
+    if(log_) {
+        result = !fclose(log_) && result;
+    }
+    if(index_) {
+        result = !fclose(index_) && result;
+    }
+    log_ = index_ = nullptr;
+    addrs_.clear();
+    cmds_.clear();
+    return result;
+}
+
+Reader::Reader(const uint8_t* log, size_t logSize, const uint8_t* index, size_t indexSize) :
+  log_{log}, logSize_{logSize}, index_{index}
+{
+    if(logSize < sizeof(LogHeader) || memcmp(log, LOG_MAGIC, sizeof(LOG_MAGIC)) || indexSize < sizeof(IndexHeader) ||
+       memcmp(index, INDEX_MAGIC, sizeof(INDEX_MAGIC))) {
+        throw std::invalid_argument("FrameLog: not a frame log");
+    }
+    auto header = Load<IndexHeader>(index);
+    addrSection_ = header.addrSection;
+    cmdSection_ = header.cmdSection;
+    count_ = header.count ? header.count : (indexSize - sizeof(IndexHeader)) / sizeof(IndexEntry);
+    // the sections are there only if the writer was closed
+    auto sectionFits = [&](uint64_t section, size_t keyCount) {
+        return !section || section + (keyCount + 1) * sizeof(uint64_t) + count_ * sizeof(uint32_t) <= indexSize;
+    };
+    if(sizeof(IndexHeader) + count_ * sizeof(IndexEntry) > indexSize || !sectionFits(addrSection_, ADDR_KEYS) ||
+       !sectionFits(cmdSection_, CMD_KEYS)) {
+        throw std::invalid_argument("FrameLog: index is truncated");
+    }
+    // group bounds must grow and stay within the record numbers
+    auto sectionOrdered = [&](uint64_t section, size_t keyCount) {
+        uint64_t prev{};
+        for(size_t key{}; section && key <= keyCount; ++key) {
+            auto start = Load<uint64_t>(index_ + section + key * sizeof(uint64_t));
+            if(start < prev || start > count_) {
+                return false;
+            }
+            prev = start;
+        }
+        return true;
+    };
+    if(!sectionOrdered(addrSection_, ADDR_KEYS) || !sectionOrdered(cmdSection_, CMD_KEYS)) {
+        throw std::invalid_argument("FrameLog: index is corrupt");
+    }
+    // records of an unfinished log may be cut off, in the header or in the payload
+    auto indexed = count_;
+    while(count_ && !RecordFits(GetEntry(count_ - 1).offset)) {
+        --count_;
+    }
+    // the sections list the cut off records too, the queries scan the records then
+    if(count_ != indexed) {
+        addrSection_ = cmdSection_ = 0;
+    }
+}
+
+bool Reader::RecordFits(uint64_t offset) const
+{
+    if(offset > logSize_ || logSize_ - offset < sizeof(RecordHeader)) {
+        return false;
+    }
+    return logSize_ - offset - sizeof(RecordHeader) >= Load<RecordHeader>(log_ + offset).n;
+}
+
+IndexEntry Reader::GetEntry(size_t i) const
+{
+    return Load<IndexEntry>(index_ + sizeof(IndexHeader) + i * sizeof(IndexEntry));
+}
+
+Record Reader::Get(size_t i) const
+{
+    auto offset = GetEntry(i).offset;
+    auto header = Load<RecordHeader>(log_ + offset);
+    return {header.timestamp,
+            header.bus,
+            header.addr,
+            header.cmd,
+            header.n,
+            (header.flags & FLAG_CRC_OK) != 0,
+            header.flags & FLAG_TX ? Direction::Tx : Direction::Rx,
+            log_ + offset + sizeof(RecordHeader)};
+}
+
+size_t Reader::LowerBound(uint64_t time) const
+{
+    size_t first{}, count = count_;
+    while(count) {
+        auto step = count / 2;
+        if(GetEntry(first + step).timestamp < time) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+std::pair<const uint32_t*, size_t> Reader::GetGroup(uint64_t section, size_t key, size_t keyCount) const
+{
+    if(!section || key >= keyCount) {
+        return {nullptr, 0};
+    }
+    auto begin = Load<uint64_t>(index_ + section + key * sizeof(uint64_t));
+    auto end = Load<uint64_t>(index_ + section + (key + 1) * sizeof(uint64_t));
+    auto numbers = reinterpret_cast<const uint32_t*>(index_ + section + (keyCount + 1) * sizeof(uint64_t));
+    return {numbers + begin, static_cast<size_t>(end - begin)};
+}
+
+size_t Reader::LowerBound(std::pair<const uint32_t*, size_t> group, uint64_t time) const
+{
+    size_t first{}, count = group.second;
+    while(count) {
+        auto step = count / 2;
+        if(GetEntry(group.first[first + step]).timestamp < time) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+} // FrameLog
+} // Wk
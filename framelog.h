@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "busmonitor.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace Wk {
+
+// Append-only binary log of frames plus a sidecar index (<path>.idx).
+//
+// Log:   LogHeader, then records: RecordHeader followed by n payload bytes, unaligned.
+// Index: IndexHeader, IndexEntry per record in log order, then the address and the command
+//        sections written by Close(): per-key start table and record numbers grouped by key,
+//        each group in time order. Timestamps don't decrease, an older one is stored as the last one.
+//        Record numbers are 32-bit, a log holds up to UINT32_MAX records.
+namespace FrameLog {
+
+constexpr char LOG_MAGIC[8] = {'W', 'A', 'K', 'E', 'L', 'O', 'G', '1'};
+constexpr char INDEX_MAGIC[8] = {'W', 'A', 'K', 'E', 'I', 'D', 'X', '1'};
+constexpr size_t ADDR_KEYS = 128;
+constexpr size_t CMD_KEYS = 256;
+
+enum class Direction : uint8_t { Rx, Tx };
+
+enum Flags : uint8_t { FLAG_CRC_OK = 0x01, FLAG_TX = 0x02 };
+
+struct LogHeader
+{
+    char magic[8];
+    uint64_t reserved;
+};
+
+struct RecordHeader
+{
+    uint64_t timestamp; // ns since the Unix epoch
+    uint16_t bus;
+    uint8_t addr;
+    uint8_t cmd;
+    uint8_t n;
+    uint8_t flags;
+    uint16_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 16);
+
+struct IndexHeader
+{
+    char magic[8];
+    uint64_t count;       // 0 until Close(), the reader derives it from the file size then
+    uint64_t addrSection; // offsets in the index file, 0 if absent
+    uint64_t cmdSection;
+};
+
+struct IndexEntry
+{
+    uint64_t timestamp;
+    uint64_t offset; // record position in the log
+    uint16_t bus;
+    uint8_t addr;
+    uint8_t cmd;
+    uint32_t reserved;
+};
+static_assert(sizeof(IndexEntry) == 24);
+
+struct Record
+{
+    uint64_t timestamp; // ns since the Unix epoch
+    uint16_t bus;
+    uint8_t addr;
+    uint8_t cmd;
+    uint8_t n;
+    bool crcOk;
+    Direction direction;
+    const uint8_t* payload;
+};
+
+class Writer
+{
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    Writer() = default;
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    ~Writer()
+    {
+        Close();
+    }
+    static constexpr uint64_t MAX_RECORDS = UINT32_MAX;
+
+    // Creates or truncates the log and its index
+    bool Open(const std::string& path);
+    // Fails once the log is full (MAX_RECORDS), the caller rolls over to a new one.
+    // timestamp is in ns since the Unix epoch, so logs of different runs and hosts line up
+    bool Append(uint64_t timestamp, uint16_t bus, const Packet_t& packet, bool crcOk, Direction direction);
+    bool Append(const MonitoredFrame& frame, uint16_t bus)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.timestamp.time_since_epoch()).count();
+        return Append(static_cast<uint64_t>(ns), bus, frame.packet, frame.crcOk, Direction::Rx);
+    }
+    bool Flush();
+    // Writes the address and command sections of the index
+    bool Close();
+    uint64_t GetCount() const
+    {
+        return count_;
+    }
+private:
+    FILE* log_{};
+    FILE* index_{};
+    std::vector<uint8_t> logBuf_;
+    std::vector<uint8_t> indexBuf_;
+    std::vector<uint8_t> addrs_, cmds_;
+    uint64_t logOffset_{};
+    uint64_t lastTimestamp_{};
+    uint64_t count_{};
+    bool ok_{};
+
+    bool WriteSection(const std::vector<uint8_t>& keys, size_t keyCount, uint64_t& sectionOffset);
+};
+
+// Works on memory images of the log and its index, e.g. MappedFile on Linux
+class Reader
+{
+public:
+    // Throws std::invalid_argument if the images are not a log and its index
+    Reader(const uint8_t* log, size_t logSize, const uint8_t* index, size_t indexSize);
+    size_t GetCount() const
+    {
+        return count_;
+    }
+    Record Get(size_t i) const;
+    // First record with timestamp >= time
+    size_t LowerBound(uint64_t time) const;
+    // Record numbers for the address or the command in time order, empty if the index wasn't closed.
+    // ForEachBy* scan the records in that case.
+    std::pair<const uint32_t*, size_t> GetByAddress(uint8_t addr) const
+    {
+        return GetGroup(addrSection_, addr, ADDR_KEYS);
+    }
+    std::pair<const uint32_t*, size_t> GetByCommand(uint8_t cmd) const
+    {
+        return GetGroup(cmdSection_, cmd, CMD_KEYS);
+    }
+    // Calls fn(record) for the records of the address in [from, to)
+    template<typename Fn>
+    void ForEachByAddress(uint8_t addr, uint64_t from, uint64_t to, Fn&& fn) const
+    {
+        if(addrSection_) {
+            ForEachInGroup(GetByAddress(addr), from, to, fn);
+        }
+        else {
+            ForEachMatching([addr](const IndexEntry& entry) { return (entry.addr & 0x7F) == addr; }, from, to, fn);
+        }
+    }
+    template<typename Fn>
+    void ForEachByCommand(uint8_t cmd, uint64_t from, uint64_t to, Fn&& fn) const
+    {
+        if(cmdSection_) {
+            ForEachInGroup(GetByCommand(cmd), from, to, fn);
+        }
+        else {
+            ForEachMatching([cmd](const IndexEntry& entry) { return entry.cmd == cmd; }, from, to, fn);
+        }
+    }
+private:
+    const uint8_t* log_;
+    size_t logSize_;
+    const uint8_t* index_;
+    size_t count_;
+    uint64_t addrSection_, cmdSection_;
+
+    IndexEntry GetEntry(size_t i) const;
+    bool RecordFits(uint64_t offset) const;
+    std::pair<const uint32_t*, size_t> GetGroup(uint64_t section, size_t key, size_t keyCount) const;
+    // First position in the group with timestamp >= time
+    size_t LowerBound(std::pair<const uint32_t*, size_t> group, uint64_t time) const;
+    template<typename Fn>
+    void ForEachInGroup(std::pair<const uint32_t*, size_t> group, uint64_t from, uint64_t to, Fn& fn) const
+    {
+        for(auto i = LowerBound(group, from); i < group.second; ++i) {
+            auto record = Get(group.first[i]);
+            if(record.timestamp >= to) {
+                break;
+            }
+            fn(record);
+        }
+    }
+    // Linear scan of an index without the sections
+    template<typename Match, typename Fn>
+    void ForEachMatching(Match match, uint64_t from, uint64_t to, Fn& fn) const
+    {
+        for(auto i = LowerBound(from); i < count_; ++i) {
+            auto entry = GetEntry(i);
+            if(entry.timestamp >= to) {
+                break;
+            }
+            if(match(entry)) {
+                fn(Get(i));
+            }
+        }
+    }
+};
+
+} // FrameLog
+} // Wk
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "groupplanner.h"
+
+#include <stdexcept>
+#include <thread>
+
+namespace Wk {
+
+namespace {
+
+bool IsNodeAddress(uint8_t addr)
+{
+    return addr && addr < 0x80 && !IsNoReplyAddress(addr);
+}
+
+} // namespace
+
+void GroupPlanner::SetGroup(uint8_t node, uint8_t group)
+{
+    if(!IsNodeAddress(node) || (group && !(ADDR_GROUP_MIN <= group && group <= ADDR_GROUP_MAX))) {
+        throw std::invalid_argument("GroupPlanner: wrong node or group address");
+    }
+    groupOf_[node] = group;
+}
+
+uint8_t GroupPlanner::GetGroup(uint8_t node) const
+{
+    return IsNodeAddress(node) ? groupOf_[node] : 0;
+}
+
+std::vector<uint8_t> GroupPlanner::GetMembers(uint8_t group) const
+{
+    std::vector<uint8_t> members;
+    for(size_t node{}; node < groupOf_.size(); ++node) {
+        if(group && groupOf_[node] == group) {
+            members.push_back(static_cast<uint8_t>(node));
+        }
+    }
+    return members;
+}
+
+bool GroupPlanner::Unicast(uint8_t node, uint8_t cmd, std::span<const uint8_t> payload, GroupPlanReport& report)
+{
+    uint8_t buf[Packet_t::BUF_SIZE];
+    MutablePacketView reply{0, 0, buf};
+    ++report.unicastRequests;
+    PacketView request{node, cmd, payload};
+    auto result = options_.timeout ? wake_.Request(request, reply, options_.timeout) : wake_.Request(request, reply);
+    // replies start with the error code, an empty one means done
+    return result && reply.cmd == cmd && (reply.payload.empty() || reply.payload[0] == ERR_NO);
+}
+
+bool GroupPlanner::Assign(uint8_t node, uint8_t group, GroupPlanReport& report)
+{
+    const uint8_t data[] = {group};
+    if(Unicast(node, C_SETGROUPADDRESS, data, report)) {
+        groupOf_[node] = group;
+        return true;
+    }
+    // A lost ack leaves the membership unknown, the node is asked to leave to make it known again.
+    // If that fails as well, it's counted as a member, so the group isn't used for sets without the node.
+    if(group) {
+        const uint8_t none[] = {0};
+        groupOf_[node] = Unicast(node, C_SETGROUPADDRESS, none, report) ? 0 : group;
+    }
+    return false;
+}
+
+void GroupPlanner::Save(uint8_t addr, GroupPlanReport& report)
+{
+    if(IsNoReplyAddress(addr)) {
+        if(wake_.Send(PacketView{addr, C_SAVESETTINGS, {}})) {
+            ++report.groupFrames;
+        }
+        else {
+            auto members = GetMembers(addr);
+            report.unsaved.insert(report.unsaved.end(), members.begin(), members.end());
+        }
+    }
+    else if(!Unicast(addr, C_SAVESETTINGS, {}, report)) {
+        report.unsaved.push_back(addr);
+    }
+}
+
+GroupPlanReport GroupPlanner::Execute(std::span<const uint8_t> nodes, uint8_t cmd, std::span<const uint8_t> payload)
+{
+    std::array<bool, 128> target{};
+    for(auto node : nodes) {
+        if(!IsNodeAddress(node)) {
+            throw std::invalid_argument("GroupPlanner: node address expected");
+        }
+        target[node] = true;
+    }
+    GroupPlanReport report;
+
+    // Groups entirely inside the set, a frame to any other would reach the nodes outside of it
+    std::array<size_t, GROUP_NUMBER> members{};
+    std::array<bool, GROUP_NUMBER> usable;
+    usable.fill(true);
+    for(size_t node{}; node < groupOf_.size(); ++node) {
+        if(auto group = groupOf_[node]) {
+            ++members[group - ADDR_GROUP_MIN];
+            usable[group - ADDR_GROUP_MIN] = usable[group - ADDR_GROUP_MIN] && target[node];
+        }
+    }
+    std::vector<uint8_t> groups;
+    for(size_t i{}; i < GROUP_NUMBER; ++i) {
+        if(members[i] && usable[i]) {
+            groups.push_back(static_cast<uint8_t>(ADDR_GROUP_MIN + i));
+        }
+    }
+    std::vector<uint8_t> rest;
+    for(size_t node{}; node < target.size(); ++node) {
+        if(target[node] && !(groupOf_[node] && usable[groupOf_[node] - ADDR_GROUP_MIN])) {
+            rest.push_back(static_cast<uint8_t>(node));
+        }
+    }
+
+    // The rest gets a group of its own, the one that takes the fewest membership requests:
+    // its members outside the set leave, the rest of the set joins. Ties go to the group with fewer
+    // members to evict, so a free one is taken before an occupied one, then to the least recently used.
+    std::array<size_t, GROUP_NUMBER> joined{};
+    for(auto node : rest) {
+        if(auto group = groupOf_[node]) {
+            ++joined[group - ADDR_GROUP_MIN];
+        }
+    }
+    size_t pick = GROUP_NUMBER;
+    size_t pickCost{};
+    size_t pickEvictions{};
+    for(size_t i{}; i < GROUP_NUMBER && !rest.empty() && rest.size() >= options_.minGroupSize; ++i) {
+        if(members[i] && usable[i]) {
+            continue;
+        }
+        auto evictions = members[i] - joined[i];
+        auto cost = evictions + (rest.size() - joined[i]);
+        if(pick == GROUP_NUMBER || cost < pickCost ||
+           (cost == pickCost && (evictions < pickEvictions ||
+                                 (evictions == pickEvictions && lastUse_[i] < lastUse_[pick])))) {
+            pick = i;
+            pickCost = cost;
+            pickEvictions = evictions;
+        }
+    }
+    if(pick < GROUP_NUMBER) {
+        auto group = static_cast<uint8_t>(ADDR_GROUP_MIN + pick);
+        // the members outside the set must leave first, a node that stays would execute the command
+        bool vacated = true;
+        std::vector<uint8_t> released;
+        for(auto node : GetMembers(group)) {
+            if(target[node]) {
+                continue;
+            }
+            if(Assign(node, 0, report)) {
+                released.push_back(node);
+            }
+            else {
+                vacated = false;
+            }
+        }
+        auto assigned = report.assigned;
+        if(vacated) {
+            std::vector<uint8_t> unassigned;
+            for(auto node : rest) {
+                if(groupOf_[node] == group) {
+                    continue;
+                }
+                if(Assign(node, group, report)) {
+                    ++report.assigned;
+                }
+                else {
+                    unassigned.push_back(node);
+                }
+            }
+            if(unassigned.size() < rest.size()) {
+                groups.push_back(group);
+            }
+            rest.swap(unassigned);
+        }
+        if(options_.persist && (report.assigned > assigned || !released.empty())) {
+            if(report.assigned > assigned) {
+                Save(group, report);
+            }
+            for(auto node : released) {
+                Save(node, report);
+            }
+            wake_.Flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(options_.saveDelayMs));
+        }
+    }
+
+    for(auto group : groups) {
+        lastUse_[group - ADDR_GROUP_MIN] = ++useCount_;
+        if(wake_.Send(PacketView{group, cmd, payload})) {
+            ++report.groupFrames;
+        }
+        else {
+            // a group frame isn't acknowledged, a TX error is all there is to know it's lost
+            auto members = GetMembers(group);
+            report.failed.insert(report.failed.end(), members.begin(), members.end());
+        }
+    }
+    for(auto node : rest) {
+        if(!Unicast(node, cmd, payload, report)) {
+            report.failed.push_back(node);
+        }
+    }
+    return report;
+}
+
+} // Wk
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wsp32.h"
+#include <array>
+#include <span>
+#include <vector>
+
+namespace Wk {
+
+struct GroupPlanOptions
+{
+    size_t minGroupSize = 4;   // fewer leftover nodes are served by unicast instead of a new group
+    bool persist = false;      // C_SAVESETTINGS after a membership change, so it survives a reboot
+    uint32_t saveDelayMs = 20; // EEPROM write time, the nodes may miss frames meanwhile
+    uint32_t timeout{};        // unicast reply timeout in ms, 0 - adaptive
+};
+
+struct GroupPlanReport
+{
+    size_t groupFrames{};
+    size_t unicastRequests{};    // command and membership requests
+    size_t assigned{};           // nodes moved to a group
+    std::vector<uint8_t> failed;  // nodes that didn't acknowledge the unicast command or whose group frame wasn't sent
+    std::vector<uint8_t> unsaved; // nodes whose new membership wasn't saved with persist on
+};
+
+// Sends the same command to a set of nodes with as few frames as possible. Groups whose members are all
+// in the set get one group frame each. The rest of the nodes are put into a free or the least recently used
+// group with C_SETGROUPADDRESS, so a repeated set costs O(1) frames, and the nodes left over go unicast.
+// A node is a member of one group at most. The planner assumes it's the only one assigning groups on the bus,
+// the memberships known from elsewhere are passed with SetGroup.
+// Group frames aren't acknowledged, so the command must be one the nodes execute without replying.
+class GroupPlanner
+{
+public:
+    static constexpr size_t GROUP_NUMBER = ADDR_GROUP_MAX - ADDR_GROUP_MIN + 1;
+
+    explicit GroupPlanner(Wake& wake, const GroupPlanOptions& options = {}) : wake_{wake}, options_{options}
+    { }
+
+    // Throws std::invalid_argument if any of the addresses isn't a node one
+    GroupPlanReport Execute(std::span<const uint8_t> nodes, uint8_t cmd, std::span<const uint8_t> payload = {});
+
+    // group: ADDR_GROUP_MIN..ADDR_GROUP_MAX, 0 - none
+    void SetGroup(uint8_t node, uint8_t group);
+    // 0 for an address that isn't a node one as well
+    uint8_t GetGroup(uint8_t node) const;
+    std::vector<uint8_t> GetMembers(uint8_t group) const;
+private:
+    Wake& wake_;
+    GroupPlanOptions options_;
+    std::array<uint8_t, 128> groupOf_{};
+    std::array<uint64_t, GROUP_NUMBER> lastUse_{};
+    uint64_t useCount_{};
+
+    bool Unicast(uint8_t node, uint8_t cmd, std::span<const uint8_t> payload, GroupPlanReport& report);
+    bool Assign(uint8_t node, uint8_t group, GroupPlanReport& report);
+    void Save(uint8_t addr, GroupPlanReport& report);
+};
+
+} // Wk
@@ -24,6 +24,13 @@
 
 #include <stdint.h>
 #include <string_view>
+#include <vector>
+
+struct IoSegment
+{
+    const uint8_t* data;
+    uint32_t size;
+};
 
 struct ISerialPort
 {
@@ -35,14 +42,45 @@ struct ISerialPort
     {
         return WriteData(&data, 1);
     }
+    // Gather write, the default one collects the segments into a single WriteData call
+    virtual bool WriteDataV(const IoSegment* segments, size_t count)
+    {
+        std::vector<uint8_t> buf;
+        for(size_t i{}; i < count; ++i) {
+            buf.insert(buf.end(), segments[i].data, segments[i].data + segments[i].size);
+        }
+        return WriteData(buf.data(), static_cast<uint32_t>(buf.size()));
+    }
     virtual bool ReadData(uint8_t* data, uint32_t size) = 0;
     bool ReadByte(uint8_t& b)
     {
         return ReadData(&b, 1);
     }
+    // Reads whatever is available, up to size bytes, waiting for the first one no longer than the timeout.
+    // Returns the number of bytes read, 0 on timeout or error
+    virtual uint32_t ReadSome(uint8_t* data, uint32_t size)
+    {
+        return size && ReadByte(*data) ? 1 : 0;
+    }
     virtual bool ResetStatus() = 0;
+    // Drops the received bytes nobody has read yet
+    virtual bool DiscardInput()
+    {
+        return true;
+    }
+    // Waits until the output has been transmitted
     virtual bool Flush() = 0;
     virtual bool SetTimeout(uint32_t to) = 0;
+    // 0 if unknown
+    virtual uint32_t GetBaudRate() const
+    {
+        return 0;
+    }
+    // OS descriptor for readiness notification, -1 if the port doesn't have one
+    virtual int GetNativeHandle() const
+    {
+        return -1;
+    }
 
     virtual ~ISerialPort() = default;
 };
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "asyncengine.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Wk {
+
+namespace {
+
+constexpr uint64_t WAKEUP_TAG = UINT64_MAX;
+
+} // namespace
+
+AsyncEngine::AsyncEngine() : epollFd_{epoll_create1(EPOLL_CLOEXEC)}, eventFd_{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
+{
+    if(epollFd_ < 0 || eventFd_ < 0) {
+        throw std::runtime_error("AsyncEngine: epoll/eventfd creation failed");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKEUP_TAG;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, eventFd_, &ev);
+}
+
+AsyncEngine::~AsyncEngine()
+{
+    closing_ = true;
+    TakeIncoming();
+    for(auto& bus : buses_) {
+        while(!bus->queue.empty()) {
+            Complete(*bus, RequestStatus::Cancelled);
+        }
+    }
+    close(eventFd_);
+    close(epollFd_);
+}
+
+size_t AsyncEngine::AddBus(ISerialPort& port)
+{
+    auto fd = port.GetNativeHandle();
+    if(fd < 0) {
+        throw std::invalid_argument("AsyncEngine: port has no descriptor, is it open?");
+    }
+    port.SetTimeout(0);
+    auto index = buses_.size();
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = index;
+    if(epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        throw std::runtime_error("AsyncEngine: unable to watch the port descriptor");
+    }
+    buses_.push_back(std::make_unique<Bus>(port));
+    return index;
+}
+
+void AsyncEngine::Submit(size_t bus, const PacketView& packet, uint32_t timeout, Callback callback)
+{
+    if(bus >= buses_.size()) {
+        throw std::out_of_range("AsyncEngine: wrong bus index");
+    }
+    // a cancelled coroutine may await again, the request would never be taken
+    if(closing_) {
+        if(callback) {
+            Packet_t request{};
+            request.addr = packet.addr;
+            request.cmd = packet.cmd;
+            request.n = static_cast<uint8_t>(std::min<size_t>(packet.payload.size(), Packet_t::BUF_SIZE));
+            std::copy_n(packet.payload.begin(), request.n, request.payload.begin());
+            callback(RequestStatus::Cancelled, request);
+        }
+        return;
+    }
+    auto pooled = pool_.Make(packet);
+    buses_[bus]->depth.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard lock{mutex_};
+        incoming_.emplace_back(bus, Transaction{std::move(pooled), timeout, std::move(callback)});
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] auto result = write(eventFd_, &one, sizeof(one));
+}
+
+std::future<Reply> AsyncEngine::Submit(size_t bus, const PacketView& packet, uint32_t timeout)
+{
+    auto promise = std::make_shared<std::promise<Reply>>();
+    auto future = promise->get_future();
+    Submit(bus, packet, timeout, [promise](RequestStatus status, Packet_t& reply) {
+        promise->set_value(Reply{status, reply});
+    });
+    return future;
+}
+
+void AsyncEngine::Schedule(uint32_t delay, std::function<void()> fn)
+{
+    if(closing_) {
+        return;
+    }
+    auto deadline = Clock::now() + std::chrono::milliseconds(delay);
+    {
+        std::lock_guard lock{mutex_};
+        incomingTimers_.push_back(Timer{deadline, timerSeq_++, std::move(fn)});
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] auto result = write(eventFd_, &one, sizeof(one));
+}
+
+void AsyncEngine::Stop()
+{
+    stopped_ = true;
+    uint64_t one = 1;
+    [[maybe_unused]] auto result = write(eventFd_, &one, sizeof(one));
+}
+
+bool AsyncEngine::RunOnce(int maxWait)
+{
+    constexpr int MAX_EVENTS = 32;
+    epoll_event events[MAX_EVENTS];
+    auto count = epoll_wait(epollFd_, events, MAX_EVENTS, GetWaitTime(maxWait));
+    for(int i = 0; i < count; ++i) {
+        if(events[i].data.u64 == WAKEUP_TAG) {
+            uint64_t value;
+            [[maybe_unused]] auto result = read(eventFd_, &value, sizeof(value));
+            TakeIncoming();
+        }
+        else {
+            auto& bus = *buses_[events[i].data.u64];
+            Receive(bus);
+            if(events[i].events & (EPOLLHUP | EPOLLERR)) {
+                Detach(bus);
+            }
+        }
+    }
+    auto now = Clock::now();
+    for(auto& bus : buses_) {
+        if(bus->busy && bus->deadline <= now) {
+            bus->stats.Add(bus->queue.front().packet->addr, WakeStats::TIMEOUTS);
+            Complete(*bus, RequestStatus::Timeout);
+            StartNext(*bus);
+        }
+    }
+    FireTimers();
+    return !stopped_;
+}
+
+int AsyncEngine::GetWaitTime(int maxWait) const
+{
+    auto now = Clock::now();
+    auto wait = maxWait;
+    for(auto& bus : buses_) {
+        if(bus->busy) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(bus->deadline - now).count();
+            if(left < 0) {
+                left = 0;
+            }
+            if(wait < 0 || left < wait) {
+                wait = static_cast<int>(left);
+            }
+        }
+    }
+    if(!timers_.empty()) {
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(timers_.front().deadline - now).count();
+        if(left < 0) {
+            left = 0;
+        }
+        if(wait < 0 || left < wait) {
+            wait = static_cast<int>(left);
+        }
+    }
+    return wait;
+}
+
+void AsyncEngine::TakeIncoming()
+{
+    decltype(incoming_) incoming;
+    {
+        std::lock_guard lock{mutex_};
+        incoming.swap(incoming_);
+        for(auto& timer : incomingTimers_) {
+            timers_.push_back(std::move(timer));
+            std::push_heap(timers_.begin(), timers_.end());
+        }
+        incomingTimers_.clear();
+    }
+    for(auto& [index, transaction] : incoming) {
+        auto& bus = *buses_[index];
+        bus.queue.push_back(std::move(transaction));
+        if(!bus.busy) {
+            StartNext(bus);
+        }
+    }
+}
+
+void AsyncEngine::StartNext(Bus& bus)
+{
+    while(!bus.busy && !bus.queue.empty()) {
+        if(bus.detached) {
+            Complete(bus, RequestStatus::TxError);
+            continue;
+        }
+        auto& packet = *bus.queue.front().packet;
+        uint8_t buf[MAX_FRAME_SIZE];
+        uint8_t crc;
+        auto size = EncodeFrame(packet.addr, packet.cmd, packet.n, packet.Payload(), buf, crc);
+        // Stale bytes belong to no one
+        bus.decoder.Clear();
+        if(!bus.port.WriteData(buf, static_cast<uint32_t>(size))) {
+            bus.stats.Add(packet.addr, WakeStats::TX_ERRORS);
+            Complete(bus, RequestStatus::TxError);
+            continue;
+        }
+        bus.stats.Add(packet.addr, WakeStats::TX_FRAMES);
+        bus.stats.Add(packet.addr, WakeStats::TX_BYTES, size);
+        if(IsNoReplyAddress(packet.addr)) {
+            bus.reply.addr = packet.addr;
+            bus.reply.cmd = packet.cmd;
+            bus.reply.n = 0;
+            Complete(bus, RequestStatus::Ok);
+        }
+        else {
+            bus.busy = true;
+            bus.sent = Clock::now();
+            bus.deadline = bus.sent + std::chrono::milliseconds(bus.queue.front().timeout);
+        }
+    }
+}
+
+void AsyncEngine::Receive(Bus& bus)
+{
+    for(;;) {
+        auto received = bus.port.ReadSome(bus.decoder.WritePtr(), static_cast<uint32_t>(bus.decoder.WriteSpace()));
+        if(!received) {
+            break;
+        }
+        bus.decoder.Commit(received);
+        bus.stats.Add(bus.busy ? bus.queue.front().packet->addr : 0, WakeStats::RX_BYTES, received);
+        if(!bus.busy) {
+            bus.decoder.Clear();
+            continue;
+        }
+        auto& reply = bus.reply;
+        auto status = bus.decoder.Decode(reply.addr, reply.cmd, reply.n, reply.payload.data(), Packet_t::BUF_SIZE);
+        while(status != FrameDecoder::Status::Incomplete) {
+            auto requestAddr = bus.queue.front().packet->addr;
+            // Frame addressed to another node is a late reply to the timed out request, skip it
+            if(status == FrameDecoder::Status::Ok && reply.addr && reply.addr != requestAddr) {
+                status = bus.decoder.Decode(reply.addr, reply.cmd, reply.n, reply.payload.data(), Packet_t::BUF_SIZE);
+                continue;
+            }
+            if(!reply.addr) {
+                reply.addr = requestAddr;
+            }
+            bus.stats.AddDecoded(requestAddr, status);
+            if(status == FrameDecoder::Status::Ok) {
+                bus.stats.AddLatency(bus.queue.front().packet->cmd,
+                                     std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - bus.sent));
+            }
+            Complete(bus, status == FrameDecoder::Status::Ok         ? RequestStatus::Ok :
+                          status == FrameDecoder::Status::CrcError ? RequestStatus::CrcError :
+                                                                     RequestStatus::FrameError);
+            StartNext(bus);
+            break;
+        }
+        if(bus.busy && bus.decoder.InFrame()) {
+            auto deadline = Clock::now() + interByteTimeout_;
+            if(deadline > bus.deadline) {
+                bus.deadline = deadline;
+            }
+        }
+    }
+}
+
+void AsyncEngine::Detach(Bus& bus)
+{
+    // a hung up descriptor stays ready, left in the set it would spin the loop
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, bus.port.GetNativeHandle(), nullptr);
+    bus.detached = true;
+    while(!bus.queue.empty()) {
+        bus.stats.Add(bus.queue.front().packet->addr, WakeStats::TX_ERRORS);
+        Complete(bus, RequestStatus::TxError);
+    }
+}
+
+void AsyncEngine::FireTimers()
+{
+    auto now = Clock::now();
+    while(!timers_.empty() && timers_.front().deadline <= now) {
+        std::pop_heap(timers_.begin(), timers_.end());
+        auto fn = std::move(timers_.back().fn);
+        timers_.pop_back();
+        fn();
+    }
+}
+
+void AsyncEngine::Complete(Bus& bus, RequestStatus status)
+{
+    auto transaction = std::move(bus.queue.front());
+    bus.queue.pop_front();
+    bus.busy = false;
+    bus.depth.fetch_sub(1, std::memory_order_relaxed);
+    if(!transaction.callback) {
+        return;
+    }
+    // a failed transaction hands back its request
+    if(status != RequestStatus::Ok) {
+        const auto& request = *transaction.packet;
+        auto n = std::min<size_t>(request.n, Packet_t::BUF_SIZE);
+        bus.reply.addr = request.addr;
+        bus.reply.cmd = request.cmd;
+        bus.reply.n = static_cast<uint8_t>(n);
+        std::copy_n(request.Payload(), n, bus.reply.payload.begin());
+    }
+    transaction.callback(status, bus.reply);
+}
+
+} // Wk
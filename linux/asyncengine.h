@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ASYNCENGINE_H
+#define ASYNCENGINE_H
+
+#include "packetpool.h"
+#include "wsp32.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Wk {
+
+struct Reply
+{
+    RequestStatus status;
+    Packet_t packet;
+};
+
+// Drives any number of buses from one thread: an epoll loop over the port descriptors.
+// Each bus has a FIFO of transactions, the head one is on the wire and the next frame
+// is written as soon as its reply is decoded or its deadline passes.
+// Submit() may be called from any thread, callbacks are invoked on the thread running the loop.
+// A bus whose port hangs up, e.g. an unplugged adapter, leaves the loop and fails its transactions
+// with RequestStatus::TxError, the ones submitted later as well.
+class AsyncEngine
+{
+public:
+    using Callback = std::function<void(RequestStatus, Packet_t&)>;
+    using Clock = std::chrono::steady_clock;
+    static constexpr uint32_t DEFAULT_INTERBYTE_TIMEOUT_MS = 20;
+
+    AsyncEngine();
+    AsyncEngine(const AsyncEngine&) = delete;
+    AsyncEngine& operator=(const AsyncEngine&) = delete;
+    // Pending transactions are completed with RequestStatus::Cancelled, so are the ones their callbacks
+    // submit meanwhile, right in Submit(). Pending timers are dropped, so are the ones scheduled meanwhile.
+    ~AsyncEngine();
+
+    // The port must be open and is used exclusively by the engine from now on, its read timeout is set to 0.
+    // Must not be called while the loop is running. Returns the bus index.
+    size_t AddBus(ISerialPort& port);
+    size_t GetBusCount() const
+    {
+        return buses_.size();
+    }
+    // The request is copied into a pooled slot that fits its payload
+    void Submit(size_t bus, const PacketView& packet, uint32_t timeout, Callback callback);
+    std::future<Reply> Submit(size_t bus, const PacketView& packet, uint32_t timeout);
+    void Submit(size_t bus, const Packet_t& packet, uint32_t timeout, Callback callback)
+    {
+        Submit(bus, packet.View(), timeout, std::move(callback));
+    }
+    std::future<Reply> Submit(size_t bus, const Packet_t& packet, uint32_t timeout)
+    {
+        return Submit(bus, packet.View(), timeout);
+    }
+    // Invokes fn on the loop thread once the delay has passed, timers with equal deadlines fire in order
+    void Schedule(uint32_t delay, std::function<void()> fn);
+    // Transactions queued or in progress on the bus
+    size_t GetQueueDepth(size_t bus) const
+    {
+        return buses_[bus]->depth.load(std::memory_order_relaxed);
+    }
+    const WakeStats& GetStats(size_t bus) const
+    {
+        return buses_[bus]->stats;
+    }
+    void SetInterByteTimeout(uint32_t to)
+    {
+        interByteTimeout_ = std::chrono::milliseconds(to);
+    }
+    // Handles ready descriptors and expired deadlines, waits no longer than maxWait (-1 - no limit).
+    // Returns false once Stop() has been called.
+    bool RunOnce(int maxWait = -1);
+    void Run()
+    {
+        while(RunOnce()) { }
+    }
+    void Stop();
+private:
+    struct Transaction
+    {
+        PacketPool::Ptr packet;
+        uint32_t timeout;
+        Callback callback;
+    };
+    struct Bus
+    {
+        Bus(ISerialPort& p) : port{p}
+        { }
+        ISerialPort& port;
+        std::deque<Transaction> queue; // front() is the active one when busy is set
+        FrameDecoder decoder;
+        Packet_t reply;
+        Clock::time_point deadline;
+        Clock::time_point sent;
+        bool busy{};
+        bool detached{}; // the port hung up
+        std::atomic<size_t> depth{};
+        WakeStats stats;
+    };
+
+    struct Timer
+    {
+        Clock::time_point deadline;
+        uint64_t seq;
+        std::function<void()> fn;
+        // min-heap on the deadline
+        bool operator<(const Timer& other) const
+        {
+            return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+        }
+    };
+
+    PacketPool pool_; // outlives the queues
+    std::vector<std::unique_ptr<Bus>> buses_;
+    std::chrono::milliseconds interByteTimeout_{DEFAULT_INTERBYTE_TIMEOUT_MS};
+    int epollFd_;
+    int eventFd_;
+    std::atomic<bool> stopped_{};
+    std::atomic<bool> closing_{}; // in the destructor, nothing is queued any more
+    std::mutex mutex_;
+    std::vector<std::pair<size_t, Transaction>> incoming_;
+    std::vector<Timer> incomingTimers_;
+    std::vector<Timer> timers_;
+    uint64_t timerSeq_{};
+
+    void TakeIncoming();
+    void StartNext(Bus& bus);
+    void Receive(Bus& bus);
+    void Detach(Bus& bus);
+    void Complete(Bus& bus, RequestStatus status);
+    void FireTimers();
+    int GetWaitTime(int maxWait) const;
+};
+
+} // Wk
+
+#endif // ASYNCENGINE_H
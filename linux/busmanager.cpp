@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "busmanager.h"
+#include "serialport.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+
+namespace Wk {
+
+WakeBusManager::WakeBusManager(Config config) : config_{config}
+{
+    if(!config_.threads) {
+        config_.threads = std::thread::hardware_concurrency();
+    }
+    if(!config_.threads) {
+        config_.threads = 1;
+    }
+}
+
+WakeBusManager::~WakeBusManager()
+{
+    Stop();
+}
+
+size_t WakeBusManager::AddBus(std::unique_ptr<ISerialPort> port)
+{
+    if(!workers_.empty() || stopped_) {
+        throw std::logic_error("WakeBusManager: buses can't be added after Start() or Stop()");
+    }
+    auto bus = routes_.size();
+    auto engine = bus % config_.threads;
+    if(engine == engines_.size()) {
+        engines_.push_back(std::make_unique<AsyncEngine>());
+    }
+    routes_.push_back({engine, engines_[engine]->AddBus(*port)});
+    ports_.push_back(std::move(port));
+    return bus;
+}
+
+size_t WakeBusManager::AddBus(std::string_view portPath, uint32_t baudRate)
+{
+    auto port = std::make_unique<SerialPort>(portPath, baudRate);
+    if(!port->OpenCOM()) {
+        throw std::runtime_error("WakeBusManager: unable to open " + std::string{portPath});
+    }
+    return AddBus(std::move(port));
+}
+
+void WakeBusManager::Start()
+{
+    // the engines are stopped for good, their loops would return at once
+    if(stopped_) {
+        throw std::logic_error("WakeBusManager: can't be restarted after Stop()");
+    }
+    if(!workers_.empty()) {
+        return;
+    }
+    auto cpuCount = std::thread::hardware_concurrency();
+    for(size_t i{}; i < engines_.size(); ++i) {
+        workers_.emplace_back([engine = engines_[i].get()] { engine->Run(); });
+        if(config_.pinThreads && cpuCount) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % cpuCount, &cpus);
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+}
+
+void WakeBusManager::Stop()
+{
+    stopped_ = true;
+    for(auto& engine : engines_) {
+        engine->Stop();
+    }
+    for(auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+void WakeBusManager::Submit(NodeId node, PacketView packet, uint32_t timeout, Callback callback)
+{
+    auto& route = routes_.at(node.bus);
+    packet.addr = node.addr;
+    engines_[route.engine]->Submit(route.index, packet, timeout, std::move(callback));
+}
+
+std::future<Reply> WakeBusManager::Submit(NodeId node, PacketView packet, uint32_t timeout)
+{
+    auto& route = routes_.at(node.bus);
+    packet.addr = node.addr;
+    return engines_[route.engine]->Submit(route.index, packet, timeout);
+}
+
+std::vector<size_t> WakeBusManager::GetQueueDepths() const
+{
+    std::vector<size_t> depths;
+    depths.reserve(routes_.size());
+    for(size_t bus{}; bus < routes_.size(); ++bus) {
+        depths.push_back(GetQueueDepth(bus));
+    }
+    return depths;
+}
+
+} // Wk
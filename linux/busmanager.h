@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef BUSMANAGER_H
+#define BUSMANAGER_H
+
+#include "asyncengine.h"
+#include <string_view>
+#include <thread>
+
+namespace Wk {
+
+struct NodeId
+{
+    size_t bus;
+    uint8_t addr;
+};
+
+// Owns a set of ports and spreads them over a pool of threads, each of them runs an AsyncEngine
+// with its share of buses. Every bus keeps its own queue, so the load of one adapter doesn't
+// hold back the others and the throughput grows with the number of adapters.
+class WakeBusManager
+{
+public:
+    using Callback = AsyncEngine::Callback;
+    struct Config
+    {
+        size_t threads = 0;      // 0 - one per hardware thread, never more than the number of buses
+        bool pinThreads = false; // bind worker N to CPU N
+    };
+
+    explicit WakeBusManager(Config config);
+    WakeBusManager() : WakeBusManager(Config{})
+    { }
+    ~WakeBusManager();
+
+    // Takes an open port, buses can be added before Start() only. Returns the bus index.
+    // Throws std::logic_error after Start() or Stop().
+    size_t AddBus(std::unique_ptr<ISerialPort> port);
+    // Opens the serial port, throws std::runtime_error on failure
+    size_t AddBus(std::string_view portPath, uint32_t baudRate);
+    // Throws std::logic_error after Stop()
+    void Start();
+    // Joins the workers, the manager can't be restarted afterwards
+    void Stop();
+
+    void Submit(NodeId node, PacketView packet, uint32_t timeout, Callback callback);
+    std::future<Reply> Submit(NodeId node, PacketView packet, uint32_t timeout);
+    void Submit(NodeId node, const Packet_t& packet, uint32_t timeout, Callback callback)
+    {
+        Submit(node, packet.View(), timeout, std::move(callback));
+    }
+    std::future<Reply> Submit(NodeId node, const Packet_t& packet, uint32_t timeout)
+    {
+        return Submit(node, packet.View(), timeout);
+    }
+    size_t GetBusCount() const
+    {
+        return routes_.size();
+    }
+    size_t GetQueueDepth(size_t bus) const
+    {
+        auto& route = routes_.at(bus);
+        return engines_[route.engine]->GetQueueDepth(route.index);
+    }
+    std::vector<size_t> GetQueueDepths() const;
+private:
+    struct Route
+    {
+        size_t engine;
+        size_t index; // bus index inside the engine
+    };
+    Config config_;
+    std::vector<std::unique_ptr<ISerialPort>> ports_;
+    std::vector<std::unique_ptr<AsyncEngine>> engines_;
+    std::vector<Route> routes_;
+    std::vector<std::thread> workers_;
+    bool stopped_{};
+};
+
+} // Wk
+
+#endif // BUSMANAGER_H
@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef CORO_H
+#define CORO_H
+
+#include "asyncengine.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace Wk {
+
+// Coroutine layer over AsyncEngine: a dialog with a device is written as straight-line code
+//   Task<> Poll(AsyncBus bus) { auto reply = co_await bus.RequestAsync(packet, 50); ... }
+// and costs one coroutine frame instead of a thread. Coroutines are resumed by the engine callbacks,
+// so they run on the thread driving the loop and need no locking between each other.
+// ~AsyncEngine resumes the coroutines suspended in a request with RequestStatus::Cancelled, the requests
+// they make afterwards are cancelled at once. It drops the pending timers without resuming their coroutines,
+// so a spawned task suspended in Sleep is never destroyed and leaks its frame: the engine must outlive those.
+
+template<typename T = void>
+class Task;
+
+namespace Detail {
+
+struct FinalAwaiter
+{
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    // Symmetric transfer to the awaiting coroutine, so long co_await chains don't grow the stack
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    {
+        auto continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept
+    { }
+};
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+    void unhandled_exception() noexcept
+    {
+        exception = std::current_exception();
+    }
+};
+
+template<typename T>
+struct Promise : PromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+    template<typename U>
+    void return_value(U&& result)
+    {
+        value.emplace(std::forward<U>(result));
+    }
+    T TakeResult()
+    {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template<>
+struct Promise<void> : PromiseBase
+{
+    Task<void> get_return_object() noexcept;
+    void return_void() const noexcept
+    { }
+    void TakeResult()
+    {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+// Fire-and-forget frame that owns the spawned task and frees itself on completion
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() const noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+        void return_void() const noexcept
+        { }
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+} // Detail
+
+// Lazily started coroutine, runs when awaited and resumes the awaiting one on completion.
+// Exceptions are propagated to the awaiter.
+template<typename T>
+class [[nodiscard]] Task
+{
+public:
+    using promise_type = Detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task(Task&& other) noexcept : handle_{std::exchange(other.handle_, {})}
+    { }
+    Task& operator=(Task&& other) noexcept
+    {
+        if(this != &other) {
+            if(handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    ~Task()
+    {
+        if(handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool IsDone() const
+    {
+        return !handle_ || handle_.done();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            Handle handle;
+            bool await_ready() const noexcept
+            {
+                return !handle || handle.done();
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume()
+            {
+                if(!handle) {
+                    throw std::logic_error("Task: awaiting an empty task");
+                }
+                return handle.promise().TakeResult();
+            }
+        };
+        return Awaiter{handle_};
+    }
+private:
+    friend promise_type;
+    template<typename U>
+    friend U RunUntilComplete(AsyncEngine& engine, Task<U> task);
+
+    explicit Task(Handle handle) : handle_{handle}
+    { }
+
+    Handle handle_;
+};
+
+namespace Detail {
+
+template<typename T>
+Task<T> Promise<T>::get_return_object() noexcept
+{
+    return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept
+{
+    return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+}
+
+inline Detached RunDetached(Task<void> task)
+{
+    co_await std::move(task);
+}
+
+} // Detail
+
+// Starts the task right away, it runs up to the first suspension on the calling thread,
+// so call it from the loop thread or before the loop is started. The task frees itself
+// on completion, an exception escaping it terminates the program like it does for std::thread.
+inline void Spawn(Task<void> task)
+{
+    Detail::RunDetached(std::move(task));
+}
+
+// Drives the engine on the calling thread until the task completes and returns its result.
+// Throws std::runtime_error if the engine is stopped first.
+template<typename T>
+T RunUntilComplete(AsyncEngine& engine, Task<T> task)
+{
+    auto handle = task.handle_;
+    handle.resume();
+    while(!handle.done()) {
+        if(!engine.RunOnce()) {
+            throw std::runtime_error("RunUntilComplete: engine has been stopped");
+        }
+    }
+    return handle.promise().TakeResult();
+}
+
+// Suspends until the reply frame is decoded, the deadline passes or the frame turns out corrupted,
+// the outcome is in Reply::status. The request is copied into the engine on suspension,
+// so the packet only has to outlive the co_await expression.
+class RequestAwaiter
+{
+public:
+    RequestAwaiter(AsyncEngine& engine, size_t bus, const PacketView& packet, uint32_t timeout) :
+        engine_{engine}, bus_{bus}, packet_{packet}, timeout_{timeout}
+    { }
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // the callback may resume the coroutine on another thread before Submit returns, don't touch this afterwards
+        engine_.Submit(bus_, packet_, timeout_, [this, handle](RequestStatus status, Packet_t& reply) {
+            reply_.emplace(Reply{status, reply});
+            handle.resume();
+        });
+    }
+    Reply await_resume()
+    {
+        return std::move(*reply_);
+    }
+private:
+    AsyncEngine& engine_;
+    size_t bus_;
+    PacketView packet_;
+    uint32_t timeout_;
+    std::optional<Reply> reply_;
+};
+
+// Suspends until the delay has passed, the coroutine isn't resumed if the engine is destroyed meanwhile
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(AsyncEngine& engine, uint32_t delay) : engine_{engine}, delay_{delay}
+    { }
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        engine_.Schedule(delay_, [handle] { handle.resume(); });
+    }
+    void await_resume() const noexcept
+    { }
+private:
+    AsyncEngine& engine_;
+    uint32_t delay_;
+};
+
+inline SleepAwaiter Sleep(AsyncEngine& engine, uint32_t delay)
+{
+    return {engine, delay};
+}
+
+// Cheap handle of one engine bus, copied into each coroutine that talks to it
+class AsyncBus
+{
+public:
+    AsyncBus(AsyncEngine& engine, size_t bus) : engine_{&engine}, bus_{bus}
+    {
+        if(bus >= engine.GetBusCount()) {
+            throw std::out_of_range("AsyncBus: wrong bus index");
+        }
+    }
+    RequestAwaiter RequestAsync(const PacketView& packet, uint32_t timeout) const
+    {
+        return {*engine_, bus_, packet, timeout};
+    }
+    RequestAwaiter RequestAsync(const Packet_t& packet, uint32_t timeout) const
+    {
+        return {*engine_, bus_, packet.View(), timeout};
+    }
+    SleepAwaiter Sleep(uint32_t delay) const
+    {
+        return {*engine_, delay};
+    }
+    AsyncEngine& GetEngine() const
+    {
+        return *engine_;
+    }
+    size_t GetIndex() const
+    {
+        return bus_;
+    }
+private:
+    AsyncEngine* engine_;
+    size_t bus_;
+};
+
+} // Wk
+
+#endif // CORO_H
@@ -23,16 +23,65 @@
 #include "serialport.h"
 
 #include <fcntl.h>
+#include <errno.h>
 #include <limits.h>
-#include <stdexcept>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
+namespace {
+
+constexpr uint32_t DEFAULT_TIMEOUT_MS = 300;
+
+timespec DeadlineAfter(uint32_t ms)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += static_cast<long>(ms % 1000) * 1000000L;
+    if(ts.tv_nsec >= 1000000000L) {
+        ts.tv_nsec -= 1000000000L;
+        ++ts.tv_sec;
+    }
+    return ts;
+}
+
+// Zero when the deadline has passed
+timespec TimeLeft(const timespec& deadline)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timespec left{deadline.tv_sec - now.tv_sec, deadline.tv_nsec - now.tv_nsec};
+    if(left.tv_nsec < 0) {
+        left.tv_nsec += 1000000000L;
+        --left.tv_sec;
+    }
+    if(left.tv_sec < 0) {
+        left = {};
+    }
+    return left;
+}
+
+} // namespace
+
 SerialPort::SerialPort(stringv portPath, uint32_t baudRate) :
-  portName_{portPath}, baudConstant_{GetBaudConstant(baudRate)}, fd_{}
+  portName_{portPath}, baudRate_{baudRate}, baudConstant_{GetBaudConstant(baudRate)}, fd_{},
+  timeout_{DEFAULT_TIMEOUT_MS}
 { }
 
+SerialPort::SerialPort(stringv portPath, uint32_t baudRate, const Profile& profile) : SerialPort(portPath, baudRate)
+{
+    profile_ = profile;
+}
+
+bool SerialPort::SetProfile(const Profile& profile)
+{
+    profile_ = profile;
+    return fd_ <= 0 || ApplyProfile();
+}
+
 bool SerialPort::AccessCOM()
 {
     return false;
@@ -48,7 +97,7 @@ bool SerialPort::OpenCOM()
         ioctl(fd_, TIOCEXCL);
         result = true;
     }
-    return result && SetPortAttributes();
+    return result && SetPortAttributes() && ApplyProfile();
 }
 
 bool SerialPort::CloseCOM()
@@ -56,15 +105,29 @@ bool SerialPort::CloseCOM()
     bool result = !close(fd_);
     if(result) {
         fd_ = 0;
+        appliedBaudRate_ = 0;
+        lowLatency_ = false;
+        rs485_ = false;
     }
     return result;
 }
 
-bool SerialPort::SetTimeout(uint32_t)
+bool SerialPort::SetTimeout(uint32_t to)
 {
+    timeout_ = to;
     return true;
 }
 
+uint32_t SerialPort::GetBaudRate() const
+{
+    return appliedBaudRate_ ? appliedBaudRate_ : baudRate_;
+}
+
+int SerialPort::GetNativeHandle() const
+{
+    return fd_ > 0 ? fd_ : -1;
+}
+
 SerialPort::~SerialPort()
 {
     if(fd_ > 0) {
@@ -74,6 +137,10 @@ SerialPort::~SerialPort()
 
 bool SerialPort::SetPortAttributes()
 {
+    // zero would be B0, which hangs up the line
+    if(!baudRate_) {
+        return false;
+    }
     termios config;
     if(tcgetattr(fd_, &config) < 0) {
         return false;
@@ -82,17 +149,15 @@ bool SerialPort::SetPortAttributes()
     cfmakeraw(&config);
 
     //
-    // 300ms timeout for the packet
-    // Inter-character timer off
+    // Non-blocking reads, the timeouts are handled with poll()
     //
     config.c_cc[VMIN] = 0;
-    config.c_cc[VTIME] = 3;
+    config.c_cc[VTIME] = 0;
 
     //
-    // Communication speed (simple version, using the predefined
-    // constants)
+    // Communication speed, the predefined constants when there is one
     //
-    if(cfsetspeed(&config, baudConstant_) < 0) {
+    if(baudConstant_ && cfsetspeed(&config, baudConstant_) < 0) {
         return false;
     }
 
@@ -102,6 +167,32 @@ bool SerialPort::SetPortAttributes()
     if(tcsetattr(fd_, TCSAFLUSH, &config) < 0) {
         return false;
     }
+
+    //
+    // Arbitrary rate, termios2 on top of the attributes above
+    //
+    if(!baudConstant_ && !SerialTuning::SetBaudRate(fd_, baudRate_)) {
+        return false;
+    }
+    // the driver rounds an arbitrary rate to its closest divisor
+    appliedBaudRate_ = SerialTuning::GetBaudRate(fd_);
+    return true;
+}
+
+bool SerialPort::ApplyProfile()
+{
+    if(profile_.lowLatency != lowLatency_ && SerialTuning::SetLowLatency(fd_, profile_.lowLatency)) {
+        lowLatency_ = profile_.lowLatency;
+    }
+    // a port that has never been switched to RS-485 mode is left alone, the ioctl fails on plain UARTs
+    if(!profile_.rs485.enabled && !rs485_) {
+        return true;
+    }
+    // on failure the port stays in the mode it was, the next call retries
+    if(!SerialTuning::SetRs485(fd_, profile_.rs485)) {
+        return false;
+    }
+    rs485_ = profile_.rs485.enabled;
     return true;
 }
 
@@ -169,18 +260,100 @@ uint32_t SerialPort::GetBaudConstant(uint32_t baudRate)
         case 4000000:
             return 0010017;
         default:
-            throw std::invalid_argument("baudRate is not in standard range" + std::to_string(baudRate));
+            return 0;
     }
 }
 
 bool SerialPort::WriteData(const uint8_t* data, uint32_t size)
 {
-    return write(fd_, data, size) > 0;
+    while(size) {
+        auto result = write(fd_, data, size);
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += result;
+        size -= static_cast<uint32_t>(result);
+    }
+    return true;
+}
+
+bool SerialPort::WriteDataV(const IoSegment* segments, size_t count)
+{
+    constexpr size_t MAX_IOV = 64;
+    iovec iov[MAX_IOV];
+    while(count) {
+        size_t iovCount{};
+        for(; iovCount < count && iovCount < MAX_IOV; ++iovCount) {
+            iov[iovCount] = {const_cast<uint8_t*>(segments[iovCount].data), segments[iovCount].size};
+        }
+        auto result = writev(fd_, iov, static_cast<int>(iovCount));
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        // skip what was written, continue from the middle of a partially written segment
+        auto written = static_cast<size_t>(result);
+        size_t i{};
+        for(; i < iovCount && written >= iov[i].iov_len; ++i) {
+            written -= iov[i].iov_len;
+        }
+        if(i < iovCount) {
+            IoSegment rest{segments[i].data + written, static_cast<uint32_t>(segments[i].size - written)};
+            if(!WriteData(rest.data, rest.size)) {
+                return false;
+            }
+            ++i;
+        }
+        segments += i;
+        count -= i;
+    }
+    return true;
+}
+
+bool SerialPort::WaitReadable(const timespec& deadline)
+{
+    pollfd pfd{fd_, POLLIN, 0};
+    for(;;) {
+        auto left = TimeLeft(deadline);
+        auto result = ppoll(&pfd, 1, &left, nullptr);
+        if(result > 0) {
+            return pfd.revents & POLLIN;
+        }
+        if(!result || errno != EINTR) {
+            return false; // timeout or error
+        }
+    }
 }
 
 bool SerialPort::ReadData(uint8_t* data, uint32_t size)
 {
-    return read(fd_, data, size) > 0;
+    auto deadline = DeadlineAfter(timeout_);
+    uint32_t total{};
+    while(total < size) {
+        if(!WaitReadable(deadline)) {
+            return false;
+        }
+        auto result = read(fd_, data + total, size - total);
+        if(result <= 0) {
+            return false;
+        }
+        total += static_cast<uint32_t>(result);
+    }
+    return true;
+}
+
+uint32_t SerialPort::ReadSome(uint8_t* data, uint32_t size)
+{
+    if(!WaitReadable(DeadlineAfter(timeout_))) {
+        return 0;
+    }
+    auto result = read(fd_, data, size);
+    return result > 0 ? static_cast<uint32_t>(result) : 0;
 }
 
 bool SerialPort::ResetStatus()
@@ -188,7 +361,12 @@ bool SerialPort::ResetStatus()
     return true;
 }
 
+bool SerialPort::DiscardInput()
+{
+    return !tcflush(fd_, TCIFLUSH);
+}
+
 bool SerialPort::Flush()
 {
-    return true;
+    return !tcdrain(fd_);
 }
@@ -23,28 +23,58 @@
 #define SERIALPORT_WIN_H
 
 #include "iserialport.h"
+#include "serialtuning.h"
 #include <string>
+#include <time.h>
 
 class SerialPort : public ISerialPort
 {
 public:
     using stringv = std::string_view;
+    struct Profile
+    {
+        bool lowLatency = false; // best effort, not every driver supports it
+        SerialTuning::Rs485Config rs485{};
+    };
+    // Rates outside the standard table are set through termios2
     SerialPort(stringv portPath, uint32_t baudRate);
+    SerialPort(stringv portPath, uint32_t baudRate, const Profile& profile);
+    // Applied on open, and right away if the port is open. Fails if RS-485 mode can't be set.
+    bool SetProfile(const Profile& profile);
+    bool IsLowLatency() const
+    {
+        return lowLatency_;
+    }
     bool AccessCOM() override;
     bool OpenCOM() override;
     bool CloseCOM() override;
     bool WriteData(const uint8_t* data, uint32_t size) override;
+    bool WriteDataV(const IoSegment* segments, size_t count) override;
     bool ReadData(uint8_t* data, uint32_t size) override;
+    uint32_t ReadSome(uint8_t* data, uint32_t size) override;
     bool ResetStatus() override;
+    bool DiscardInput() override;
     bool Flush() override;
     bool SetTimeout(uint32_t to) override;
+    // Read back from the driver once the port is open, the requested rate before that
+    uint32_t GetBaudRate() const override;
+    int GetNativeHandle() const override;
     ~SerialPort() override;
 private:
     const std::string portName_;
+    uint32_t baudRate_;
     uint32_t baudConstant_;
+    uint32_t appliedBaudRate_{};
     int32_t fd_;
+    uint32_t timeout_;
+    Profile profile_;
+    bool lowLatency_{};
+    bool rs485_{};
 
     bool SetPortAttributes();
+    bool ApplyProfile();
+    bool WaitReadable(const timespec& deadline);
+    // 0 for a rate without the predefined constant
     static uint32_t GetBaudConstant(uint32_t baudRate);
 };
 
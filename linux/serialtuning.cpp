@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "serialtuning.h"
+
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+
+namespace SerialTuning {
+
+bool SetBaudRate(int fd, uint32_t baudRate)
+{
+    termios2 config;
+    if(ioctl(fd, TCGETS2, &config) < 0) {
+        return false;
+    }
+    config.c_cflag &= ~CBAUD;
+    config.c_cflag |= BOTHER;
+    config.c_ispeed = baudRate;
+    config.c_ospeed = baudRate;
+    return ioctl(fd, TCSETS2, &config) == 0;
+}
+
+uint32_t GetBaudRate(int fd)
+{
+    termios2 config;
+    if(ioctl(fd, TCGETS2, &config) < 0) {
+        return 0;
+    }
+    return config.c_ospeed;
+}
+
+bool SetLowLatency(int fd, bool enable)
+{
+    serial_struct serial;
+    if(ioctl(fd, TIOCGSERIAL, &serial) < 0) {
+        return false;
+    }
+    if(enable) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    }
+    else {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    return ioctl(fd, TIOCSSERIAL, &serial) == 0;
+}
+
+bool SetRs485(int fd, const Rs485Config& config)
+{
+    serial_rs485 rs485{};
+    if(config.enabled) {
+        rs485.flags = SER_RS485_ENABLED;
+        rs485.flags |= config.rtsOnSend ? SER_RS485_RTS_ON_SEND : SER_RS485_RTS_AFTER_SEND;
+        if(config.rxDuringTx) {
+            rs485.flags |= SER_RS485_RX_DURING_TX;
+        }
+        rs485.delay_rts_before_send = config.delayBeforeSendMs;
+        rs485.delay_rts_after_send = config.delayAfterSendMs;
+    }
+    return ioctl(fd, TIOCSRS485, &rs485) == 0;
+}
+
+} // SerialTuning
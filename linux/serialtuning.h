@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef SERIALTUNING_H
+#define SERIALTUNING_H
+
+#include <stdint.h>
+
+// Linux specific knobs of the tty layer. Kept apart from serialport.cpp because
+// <asm/termbits.h> (termios2) can't be included together with <termios.h>.
+namespace SerialTuning {
+
+// Kernel driven transmitter enable, the driver toggles RTS around each write
+struct Rs485Config
+{
+    bool enabled = false;
+    bool rtsOnSend = true;         // RTS level while sending, the opposite one after
+    bool rxDuringTx = false;       // keep the receiver on to see the own echo
+    uint32_t delayBeforeSendMs{};  // RTS set -> first bit
+    uint32_t delayAfterSendMs{};   // last bit -> RTS released
+};
+
+// Any rate via termios2/BOTHER, the driver picks the closest divisor. The other attributes are kept.
+bool SetBaudRate(int fd, uint32_t baudRate);
+// Rate the driver actually applied, 0 on failure
+uint32_t GetBaudRate(int fd);
+// ASYNC_LOW_LATENCY: USB adapters flush RX at once instead of batching it for up to 16 ms
+bool SetLowLatency(int fd, bool enable);
+bool SetRs485(int fd, const Rs485Config& config);
+
+} // SerialTuning
+
+#endif // SERIALTUNING_H
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "wakesimulator.h"
+#include "bulktransfer.h"
+#include "crc.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace Wk {
+
+namespace {
+
+bool IsNodeAddress(uint8_t addr)
+{
+    return addr && addr < 0x80 && !IsNoReplyAddress(addr);
+}
+
+uint32_t GetLe(const uint8_t* buf, size_t size)
+{
+    uint32_t value{};
+    for(size_t i{}; i < size; ++i) {
+        value |= static_cast<uint32_t>(buf[i]) << (i * 8);
+    }
+    return value;
+}
+
+} // namespace
+
+Simulator::Simulator() : master_{posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC)}, slave_{-1}, stopEvent_{-1}
+{
+    char name[128];
+    if(master_ < 0 || grantpt(master_) || unlockpt(master_) || ptsname_r(master_, name, sizeof(name))) {
+        throw std::runtime_error("Simulator: unable to create pseudo-terminal");
+    }
+    portPath_ = name;
+    // Keep the slave side open and raw, so nothing is echoed back and the master doesn't see a hangup
+    // while the port is reopened
+    slave_ = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    termios config;
+    if(slave_ < 0 || tcgetattr(slave_, &config)) {
+        throw std::runtime_error("Simulator: unable to open " + portPath_);
+    }
+    cfmakeraw(&config);
+    tcsetattr(slave_, TCSANOW, &config);
+    stopEvent_ = eventfd(0, EFD_CLOEXEC);
+}
+
+Simulator::~Simulator()
+{
+    Stop();
+    close(stopEvent_);
+    close(slave_);
+    close(master_);
+}
+
+bool Simulator::AddNode(uint8_t addr, const Node& node)
+{
+    if(!IsNodeAddress(addr)) {
+        return false;
+    }
+    std::lock_guard lock{mutex_};
+    nodes_[addr] = node;
+    return true;
+}
+
+bool Simulator::RemoveNode(uint8_t addr)
+{
+    std::lock_guard lock{mutex_};
+    return nodes_.erase(addr) != 0;
+}
+
+bool Simulator::GetNode(uint8_t addr, Node& node) const
+{
+    std::lock_guard lock{mutex_};
+    auto it = nodes_.find(addr);
+    if(it == nodes_.end()) {
+        return false;
+    }
+    node = it->second;
+    return true;
+}
+
+void Simulator::Start()
+{
+    if(!thread_.joinable()) {
+        thread_ = std::thread{&Simulator::Run, this};
+    }
+}
+
+void Simulator::Stop()
+{
+    if(thread_.joinable()) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto result = write(stopEvent_, &one, sizeof(one));
+        thread_.join();
+        uint64_t value;
+        result = read(stopEvent_, &value, sizeof(value));
+    }
+}
+
+void Simulator::Run()
+{
+    FrameDecoder decoder;
+    Packet_t packet;
+    pollfd fds[2] = {{master_, POLLIN, 0}, {stopEvent_, POLLIN, 0}};
+    for(;;) {
+        if(poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if(fds[1].revents & POLLIN) {
+            break;
+        }
+        if(!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        auto received = read(master_, decoder.WritePtr(), decoder.WriteSpace());
+        if(received <= 0) {
+            continue;
+        }
+        decoder.Commit(static_cast<size_t>(received));
+        for(;;) {
+            auto status = decoder.Decode(packet.addr, packet.cmd, packet.n, packet.payload.data(), Packet_t::BUF_SIZE);
+            if(status == FrameDecoder::Status::Incomplete) {
+                break;
+            }
+            if(status != FrameDecoder::Status::Ok) {
+                errors_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            rxFrames_.fetch_add(1, std::memory_order_relaxed);
+            Process(packet);
+        }
+    }
+}
+
+void Simulator::Process(Packet_t& packet)
+{
+    std::unique_lock lock{mutex_};
+    if(IsNoReplyAddress(packet.addr)) {
+        for(auto& [addr, node] : nodes_) {
+            if(packet.addr == ADDR_BROADCAST || packet.addr == node.groupAddr) {
+                Packet_t copy = packet;
+                bool moved;
+                if(packet.cmd != C_SETNODEADDRESS) {
+                    Execute(addr, node, copy, moved);
+                }
+            }
+        }
+        return;
+    }
+    auto it = nodes_.find(packet.addr);
+    if(it == nodes_.end()) {
+        return;
+    }
+    bool moved{};
+    auto latency = it->second.latency;
+    if(!Execute(packet.addr, it->second, packet, moved)) {
+        return;
+    }
+    if(moved) {
+        auto node = it->second;
+        nodes_.erase(it);
+        nodes_[packet.payload[1]] = node;
+    }
+    lock.unlock();
+    Reply(packet, latency);
+}
+
+bool Simulator::Execute(uint8_t addr, Node& node, Packet_t& packet, bool& moved)
+{
+    auto& data = packet.payload;
+    auto reply = [&packet](std::initializer_list<uint8_t> values) {
+        std::copy(values.begin(), values.end(), packet.payload.begin());
+        packet.n = static_cast<uint8_t>(values.size());
+    };
+    moved = false;
+    switch(packet.cmd) {
+        case C_NOP:
+            packet.n = 0;
+            break;
+        case C_ECHO:
+            break;
+        case C_GETINFO:
+            if(!packet.n) {
+                reply({ERR_NO, node.deviceMask, node.protocolVersion});
+            }
+            else if(data[0] >= DEV_TYPES_NUMBER || !(node.deviceMask & (1U << data[0]))) {
+                reply({ERR_PA});
+            }
+            else {
+                auto info = node.moduleInfo[data[0]];
+                if(data[0] == DEV_POWER_SUPPLY && info > 0xFF) {
+                    reply({ERR_NO, static_cast<uint8_t>(info), static_cast<uint8_t>(info >> 8)});
+                }
+                else {
+                    reply({ERR_NO, static_cast<uint8_t>(info)});
+                }
+            }
+            break;
+        case C_SETNODEADDRESS:
+            if(packet.n != 1 || !IsNodeAddress(data[0]) || (data[0] != addr && nodes_.count(data[0]))) {
+                reply({ERR_ADDRFMT});
+            }
+            else {
+                moved = data[0] != addr;
+                reply({ERR_NO, data[0]});
+            }
+            break;
+        case C_SETGROUPADDRESS:
+            if(packet.n != 1 || (data[0] && !(ADDR_GROUP_MIN <= data[0] && data[0] <= ADDR_GROUP_MAX))) {
+                reply({ERR_ADDRFMT});
+            }
+            else {
+                node.groupAddr = data[0];
+                reply({ERR_NO, data[0]});
+            }
+            break;
+        case C_GETOPTIME:
+            reply({ERR_NO, static_cast<uint8_t>(node.opTime), static_cast<uint8_t>(node.opTime >> 8),
+                   static_cast<uint8_t>(node.opTime >> 16), static_cast<uint8_t>(node.opTime >> 24)});
+            break;
+        case C_OFF:
+        case C_ON:
+        case C_TOGGLE_ONOFF:
+            node.on = packet.cmd == C_TOGGLE_ONOFF ? !node.on : packet.cmd == C_ON;
+            reply({ERR_NO, node.on});
+            break;
+        case C_SAVESETTINGS:
+        case C_REBOOT:
+            reply({ERR_NO});
+            break;
+        case C_BULK_BEGIN:
+        case C_BULK_DATA:
+        case C_BULK_STATUS:
+        case C_BULK_END:
+            return ExecuteBulk(node, packet);
+        default:
+            reply({ERR_NI});
+            break;
+    }
+    return true;
+}
+
+bool Simulator::ExecuteBulk(Node& node, Packet_t& packet)
+{
+    auto& data = packet.payload;
+    auto& bulk = node.bulk;
+    auto reply = [&packet](std::initializer_list<uint8_t> values) {
+        std::copy(values.begin(), values.end(), packet.payload.begin());
+        packet.n = static_cast<uint8_t>(values.size());
+        return true;
+    };
+    switch(packet.cmd) {
+        case C_BULK_BEGIN: {
+            if(packet.n != 7) {
+                return reply({ERR_PA});
+            }
+            auto size = GetLe(&data[0], 4);
+            if(size > node.bulkMaxSize) {
+                return reply({ERR_PA});
+            }
+            bulk.active = true;
+            bulk.flags = data[6];
+            bulk.dataFrames = 0;
+            bulk.data.assign(size, 0);
+            bulk.received.assign(GetLe(&data[4], 2), false);
+            return reply({ERR_NO});
+        }
+        case C_BULK_DATA: {
+            // unacknowledged frames are silently dropped on errors as well
+            bool ack = bulk.flags & BULK_ACK_EACH;
+            if(node.bulkDropInterval && ++bulk.dataFrames % node.bulkDropInterval == 0) {
+                return false;
+            }
+            if(!bulk.active || packet.n < 6) {
+                return ack && reply({ERR_RE});
+            }
+            auto index = GetLe(&data[0], 2);
+            auto offset = GetLe(&data[2], 4);
+            size_t size = packet.n - 6U;
+            if(index >= bulk.received.size() || offset > bulk.data.size() || size > bulk.data.size() - offset) {
+                return ack && reply({ERR_PA});
+            }
+            std::copy_n(&data[6], size, bulk.data.begin() + offset);
+            bulk.received[index] = true;
+            return ack && reply({ERR_NO, data[0], data[1]});
+        }
+        case C_BULK_STATUS: {
+            if(!bulk.active) {
+                return reply({ERR_RE});
+            }
+            if(packet.n != 3 || data[2] > 64) {
+                return reply({ERR_PA});
+            }
+            auto first = GetLe(&data[0], 2);
+            uint8_t count = data[2];
+            packet.n = static_cast<uint8_t>(3 + (count + 7) / 8);
+            std::fill(&data[3], &data[packet.n], 0);
+            for(uint32_t i{}; i < count; ++i) {
+                if(first + i < bulk.received.size() && bulk.received[first + i]) {
+                    data[3 + i / 8] |= static_cast<uint8_t>(1U << (i % 8));
+                }
+            }
+            data[0] = ERR_NO;
+            data[1] = static_cast<uint8_t>(first);
+            data[2] = static_cast<uint8_t>(first >> 8);
+            return true;
+        }
+        case C_BULK_END: {
+            if(!bulk.active) {
+                return reply({ERR_RE});
+            }
+            if(packet.n != 4) {
+                return reply({ERR_PA});
+            }
+            if(std::find(bulk.received.begin(), bulk.received.end(), false) != bulk.received.end()) {
+                return reply({ERR_RE});
+            }
+            bulk.active = false;
+            if(Mcudrv::Crc::Crc32{}(bulk.data.data(), bulk.data.size()).GetResult() != GetLe(&data[0], 4)) {
+                return reply({ERR_PA});
+            }
+            node.image = std::move(bulk.data);
+            return reply({ERR_NO});
+        }
+    }
+    return false;
+}
+
+void Simulator::Reply(const Packet_t& packet, std::chrono::microseconds latency)
+{
+    if(latency.count()) {
+        std::this_thread::sleep_for(latency);
+    }
+    uint8_t buf[MAX_FRAME_SIZE];
+    uint8_t crc;
+    auto size = EncodeFrame(packet.addr, packet.cmd, packet.n, packet.payload.data(), buf, crc);
+    size_t written{};
+    while(written < size) {
+        auto result = write(master_, buf + written, size - written);
+        if(result <= 0) {
+            return;
+        }
+        written += static_cast<size_t>(result);
+    }
+    txFrames_.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // Wk
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef WAKESIMULATOR_H
+#define WAKESIMULATOR_H
+
+#include "wsp32.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Wk {
+
+// Firmware side of the protocol behind a pseudo-terminal: the slave end is a regular tty,
+// so SerialPort opens GetPortPath() as is. The nodes are served by a single thread in the order
+// the frames arrive, each reply is delayed by the node latency.
+class Simulator
+{
+public:
+    // C_BULK_* transfer in progress
+    struct BulkState
+    {
+        bool active{};
+        uint8_t flags{};
+        uint32_t dataFrames{};
+        std::vector<uint8_t> data;
+        std::vector<bool> received; // per chunk
+    };
+    struct Node
+    {
+        uint8_t deviceMask = 1U << DEV_LED_DRIVER;
+        uint8_t protocolVersion = 0x10; // major.minor in nibbles
+        // C_GETINFO module reply: LED driver flags, channels, memory size, sensor type mask,
+        // nominal power (W) or custom ID, indexed by DeviceType
+        std::array<uint16_t, DEV_TYPES_NUMBER> moduleInfo{};
+        std::chrono::microseconds latency{};
+        uint32_t opTime{}; // seconds
+        uint8_t groupAddr{};
+        bool on{};
+        uint32_t bulkDropInterval{}; // every Nth C_BULK_DATA frame is lost, 0 - none
+        uint32_t bulkMaxSize = 1U << 20;
+        std::vector<uint8_t> image; // the last image completed with C_BULK_END
+        BulkState bulk;
+    };
+    struct Counters
+    {
+        uint64_t rxFrames;
+        uint64_t txFrames;
+        uint64_t errors; // frames dropped by the decoder
+    };
+
+    // Throws std::runtime_error if the pty can't be created
+    Simulator();
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+    ~Simulator();
+
+    const std::string& GetPortPath() const
+    {
+        return portPath_;
+    }
+    // addr: 1..127 outside of the group range
+    bool AddNode(uint8_t addr, const Node& node);
+    bool RemoveNode(uint8_t addr);
+    // Copy of the current node state
+    bool GetNode(uint8_t addr, Node& node) const;
+    void Start();
+    void Stop();
+    Counters GetCounters() const
+    {
+        return {rxFrames_.load(std::memory_order_relaxed), txFrames_.load(std::memory_order_relaxed),
+                errors_.load(std::memory_order_relaxed)};
+    }
+private:
+    int master_, slave_, stopEvent_;
+    std::string portPath_;
+    mutable std::mutex mutex_;
+    std::map<uint8_t, Node> nodes_;
+    std::thread thread_;
+    std::atomic<uint64_t> rxFrames_{}, txFrames_{}, errors_{};
+
+    void Run();
+    void Process(Packet_t& packet);
+    // Fills the reply, returns false if the node doesn't answer
+    bool Execute(uint8_t addr, Node& node, Packet_t& packet, bool& moved);
+    static bool ExecuteBulk(Node& node, Packet_t& packet);
+    void Reply(const Packet_t& packet, std::chrono::microseconds latency);
+};
+
+} // Wk
+
+#endif // WAKESIMULATOR_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "packetpool.h"
+#include <new>
+#include <stdexcept>
+#include <string.h>
+
+namespace Wk {
+
+PacketPool::Ptr PacketPool::Make(const PacketView& packet)
+{
+    if(packet.payload.size() > CLASS_CAPACITY.back()) {
+        throw std::invalid_argument("PacketPool: payload is longer than 255 bytes");
+    }
+    auto n = static_cast<uint8_t>(packet.payload.size());
+    Ptr result{Allocate(packet.addr, packet.cmd, n), Deleter{this}};
+    if(n) {
+        memcpy(result->Payload(), packet.payload.data(), n);
+    }
+    return result;
+}
+
+PooledPacket* PacketPool::Allocate(uint8_t addr, uint8_t cmd, uint8_t n)
+{
+    size_t sizeClass{};
+    while(CLASS_CAPACITY[sizeClass] < n) {
+        ++sizeClass;
+    }
+    void* slot;
+    {
+        std::lock_guard lock{mutex_};
+        if(free_[sizeClass]) {
+            slot = free_[sizeClass];
+            free_[sizeClass] = free_[sizeClass]->next;
+        }
+        else {
+            auto size = GetSlotSize(sizeClass);
+            if(left_ < size) {
+                // the tail of the previous chunk is too small for this class and stays unused
+                chunks_.emplace_back(new uint8_t[CHUNK_SIZE]);
+                next_ = chunks_.back().get();
+                left_ = CHUNK_SIZE;
+            }
+            slot = next_;
+            next_ += size;
+            left_ -= size;
+        }
+    }
+    return new(slot) PooledPacket{addr, cmd, n, static_cast<uint8_t>(sizeClass)};
+}
+
+void PacketPool::Free(PooledPacket* packet)
+{
+    if(!packet) {
+        return;
+    }
+    auto sizeClass = packet->sizeClass;
+    auto slot = new(packet) FreeSlot;
+    std::lock_guard lock{mutex_};
+    slot->next = free_[sizeClass];
+    free_[sizeClass] = slot;
+}
+
+} // Wk
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wsp32.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Wk {
+
+// Header of a pooled packet, the payload follows it in the same slot
+struct PooledPacket
+{
+    uint8_t addr;
+    uint8_t cmd;
+    uint8_t n;
+    uint8_t sizeClass;
+
+    uint8_t* Payload()
+    {
+        return reinterpret_cast<uint8_t*>(this + 1);
+    }
+    const uint8_t* Payload() const
+    {
+        return reinterpret_cast<const uint8_t*>(this + 1);
+    }
+    PacketView View() const
+    {
+        return {addr, cmd, {Payload(), n}};
+    }
+};
+
+// Packets in size classes carved from large chunks, so a queued request takes a slot
+// that fits its payload. Freed slots go to per-class free lists, chunks are returned on destruction.
+// Thread safe; the pool must outlive the packets it gave out.
+class PacketPool
+{
+public:
+    static constexpr std::array<size_t, 4> CLASS_CAPACITY = {8, 32, 96, 255};
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Deleter
+    {
+        PacketPool* pool;
+        void operator()(PooledPacket* packet) const
+        {
+            pool->Free(packet);
+        }
+    };
+    using Ptr = std::unique_ptr<PooledPacket, Deleter>;
+
+    PacketPool() = default;
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    // Throws std::invalid_argument for more than 255 payload bytes
+    Ptr Make(const PacketView& packet);
+    Ptr Make(const Packet_t& packet)
+    {
+        return Make(packet.View());
+    }
+    // Payload is left uninitialized
+    PooledPacket* Allocate(uint8_t addr, uint8_t cmd, uint8_t n);
+    void Free(PooledPacket* packet);
+    size_t GetChunkCount() const
+    {
+        std::lock_guard lock{mutex_};
+        return chunks_.size();
+    }
+private:
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+    static constexpr size_t GetSlotSize(size_t sizeClass)
+    {
+        // keeps every slot aligned for FreeSlot
+        constexpr size_t align = alignof(FreeSlot);
+        return (sizeof(PooledPacket) + CLASS_CAPACITY[sizeClass] + align - 1) / align * align;
+    }
+
+    mutable std::mutex mutex_;
+    std::array<FreeSlot*, CLASS_CAPACITY.size()> free_{};
+    std::vector<std::unique_ptr<uint8_t[]>> chunks_;
+    uint8_t* next_{};
+    size_t left_{};
+};
+
+} // Wk
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pollscheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Wk {
+
+namespace {
+
+constexpr uint64_t BITS_PER_BYTE = 10; // 8N1
+constexpr int COST_SMOOTHING_SHIFT = 3; // EWMA weight 1/8 of the measured bus time
+
+} // namespace
+
+PollScheduler::PollScheduler(Wake& wake, const PollOptions& options) : wake_{wake}, options_{options}
+{
+    if(!options_.baudRate) {
+        options_.baudRate = wake.GetBaudRate();
+    }
+    if(!options_.baudRate) {
+        throw std::invalid_argument("PollScheduler: baud rate is unknown");
+    }
+}
+
+std::chrono::microseconds PollScheduler::GetCost(const Packet_t& request, size_t replySize) const
+{
+    uint8_t buf[MAX_FRAME_SIZE];
+    uint8_t crc;
+    auto requestSize = EncodeFrame(request.addr, request.cmd, request.n, request.payload.data(), buf, crc);
+    // FEND, ADD, CMD, N, data, CRC; the stuffing of the reply isn't known in advance, the measured cost covers it
+    auto replyWireSize = 1 + 3 + replySize + 1;
+    auto bits = (requestSize + replyWireSize) * BITS_PER_BYTE;
+    auto us = (bits * 1000000 + options_.baudRate - 1) / options_.baudRate + options_.turnaroundUs;
+    return std::chrono::microseconds(us);
+}
+
+bool PollScheduler::Admit(const PollTask& task, std::chrono::microseconds cost) const
+{
+    auto deadline = GetDeadline(task);
+    if(cost > deadline) {
+        return false;
+    }
+    double density = static_cast<double>(cost.count()) / static_cast<double>(deadline.count());
+    auto maxCost = cost;
+    auto minDeadline = deadline;
+    for(auto& [id, entry] : tasks_) {
+        auto taskDeadline = GetDeadline(entry->task);
+        density += static_cast<double>(entry->cost.count()) / static_cast<double>(taskDeadline.count());
+        maxCost = std::max(maxCost, entry->cost);
+        minDeadline = std::min(minDeadline, taskDeadline);
+    }
+    // a job that has just taken the bus delays the most urgent one by its whole cost
+    auto blocking = static_cast<double>(maxCost.count()) / static_cast<double>(minDeadline.count());
+    return density + blocking <= options_.utilizationLimit;
+}
+
+std::optional<PollScheduler::TaskId> PollScheduler::AddTask(PollTask task)
+{
+    if(task.period.count() <= 0 || task.deadline.count() < 0 || task.deadline > task.period) {
+        throw std::invalid_argument("PollScheduler: period must be positive, deadline within the period");
+    }
+    if(IsNoReplyAddress(task.request.addr)) {
+        throw std::invalid_argument("PollScheduler: node address expected");
+    }
+    auto cost = GetCost(task.request, task.replySize);
+    std::lock_guard lock{mutex_};
+    if(!Admit(task, cost)) {
+        return std::nullopt;
+    }
+    auto id = nextId_++;
+    auto entry = std::make_shared<Entry>();
+    entry->task = std::move(task);
+    entry->release = Clock::now();
+    entry->cost = cost;
+    tasks_.emplace(id, entry);
+    pending_.push_back(Job{entry->release, id});
+    std::push_heap(pending_.begin(), pending_.end());
+    cv_.notify_one();
+    return id;
+}
+
+bool PollScheduler::RemoveTask(TaskId id)
+{
+    // the queued jobs of the task are dropped when they come up
+    std::lock_guard lock{mutex_};
+    return tasks_.erase(id) != 0;
+}
+
+std::optional<PollStats> PollScheduler::GetStats(TaskId id) const
+{
+    std::lock_guard lock{mutex_};
+    auto it = tasks_.find(id);
+    if(it == tasks_.end()) {
+        return std::nullopt;
+    }
+    auto stats = it->second->stats;
+    stats.cost = it->second->cost;
+    stats.jitter = it->second->jitter.GetSnapshot();
+    return stats;
+}
+
+double PollScheduler::GetUtilization() const
+{
+    std::lock_guard lock{mutex_};
+    double utilization{};
+    for(auto& [id, entry] : tasks_) {
+        utilization += static_cast<double>(entry->cost.count()) / static_cast<double>(entry->task.period.count());
+    }
+    return utilization;
+}
+
+void PollScheduler::RunUntil(Clock::time_point until)
+{
+    uint64_t stopCount;
+    {
+        std::lock_guard lock{mutex_};
+        if(running_) {
+            throw std::logic_error("PollScheduler: the tasks are served on another thread");
+        }
+        running_ = true;
+        stopCount = stopCount_;
+    }
+    Run(until, stopCount);
+}
+
+void PollScheduler::Run(Clock::time_point until, uint64_t stopCount)
+{
+    std::unique_lock lock{mutex_};
+    // a throwing handler leaves the lock released
+    struct Release
+    {
+        std::unique_lock<std::mutex>& lock;
+        bool& running;
+        ~Release()
+        {
+            if(!lock.owns_lock()) {
+                lock.lock();
+            }
+            running = false;
+        }
+    } release{lock, running_};
+    while(stopCount == stopCount_) {
+        auto now = Clock::now();
+        if(now >= until) {
+            break;
+        }
+        while(!pending_.empty() && pending_.front().key <= now) {
+            std::pop_heap(pending_.begin(), pending_.end());
+            auto job = pending_.back();
+            pending_.pop_back();
+            auto it = tasks_.find(job.id);
+            if(it != tasks_.end()) {
+                ready_.push_back(Job{job.key + GetDeadline(it->second->task), job.id});
+                std::push_heap(ready_.begin(), ready_.end());
+            }
+        }
+        if(ready_.empty()) {
+            auto wakeup = pending_.empty() ? until : std::min(until, pending_.front().key);
+            if(wakeup == Clock::time_point::max()) {
+                cv_.wait(lock);
+            }
+            else {
+                cv_.wait_until(lock, wakeup);
+            }
+            continue;
+        }
+        std::pop_heap(ready_.begin(), ready_.end());
+        auto id = ready_.back().id;
+        ready_.pop_back();
+        auto it = tasks_.find(id);
+        if(it != tasks_.end()) {
+            auto entry = it->second;
+            RunJob(lock, id, entry);
+        }
+    }
+}
+
+void PollScheduler::RunJob(std::unique_lock<std::mutex>& lock, TaskId id, const std::shared_ptr<Entry>& entry)
+{
+    const auto& task = entry->task;
+    auto& stats = entry->stats;
+    auto now = Clock::now();
+    while(entry->release + task.period <= now) {
+        entry->release += task.period;
+        ++stats.skipped;
+        ++stats.missed;
+    }
+    auto release = entry->release;
+    auto deadline = release + GetDeadline(task);
+    auto packet = task.request;
+    lock.unlock();
+
+    auto start = Clock::now();
+    // the node timeout follows its latency, but never past the deadline
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - start).count();
+    auto timeLeft = static_cast<uint32_t>(std::max<decltype(left)>(left, 1));
+    bool result = wake_.GetRtoEstimator().GetTimeout(packet.addr) <= timeLeft ? wake_.Request(packet) :
+                                                                                 wake_.Request(packet, timeLeft);
+    auto finish = Clock::now();
+    auto status = result ? RequestStatus::Ok : wake_.GetLastStatus();
+    if(task.handler) {
+        task.handler(status, packet);
+    }
+
+    lock.lock();
+    auto jitter = std::chrono::duration_cast<std::chrono::microseconds>(start - release);
+    entry->jitter.Add(jitter);
+    stats.maxJitter = std::max(stats.maxJitter, jitter);
+    ++stats.runs;
+    if(!result) {
+        ++stats.failures;
+    }
+    if(finish > deadline) {
+        ++stats.missed;
+    }
+    auto busTime = std::chrono::duration_cast<std::chrono::microseconds>(finish - start);
+    entry->cost += (busTime - entry->cost) / (1 << COST_SMOOTHING_SHIFT);
+    entry->release += task.period;
+    if(tasks_.count(id)) {
+        pending_.push_back(Job{entry->release, id});
+        std::push_heap(pending_.begin(), pending_.end());
+    }
+}
+
+void PollScheduler::Start()
+{
+    std::unique_lock lock{mutex_};
+    auto stopCount = stopCount_;
+    if(thread_.joinable()) {
+        // still running unless a handler has stopped it
+        if(stopCount == threadStopCount_) {
+            return;
+        }
+        lock.unlock();
+        thread_.join();
+        lock.lock();
+        stopCount = stopCount_;
+    }
+    if(running_) {
+        throw std::logic_error("PollScheduler: the tasks are served by RunUntil");
+    }
+    running_ = true;
+    threadStopCount_ = stopCount;
+    thread_ = std::thread{[this, stopCount] { Run(Clock::time_point::max(), stopCount); }};
+}
+
+void PollScheduler::Stop()
+{
+    {
+        std::lock_guard lock{mutex_};
+        ++stopCount_;
+    }
+    cv_.notify_all();
+    // a handler can't wait for its own thread
+    if(thread_.joinable() && std::this_thread::get_id() != thread_.get_id()) {
+        thread_.join();
+    }
+}
+
+} // Wk
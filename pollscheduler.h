@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "stats.h"
+#include "wsp32.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace Wk {
+
+struct PollTask
+{
+    using Handler = std::function<void(RequestStatus status, const Packet_t& reply)>;
+    Packet_t request;
+    std::chrono::microseconds period;
+    std::chrono::microseconds deadline{}; // after the release, 0 - the period
+    size_t replySize = 8;                 // expected reply payload, for the cost estimate
+    Handler handler;                      // called on the scheduler thread
+};
+
+struct PollOptions
+{
+    uint32_t baudRate{};          // 0 - the port one
+    uint32_t turnaroundUs = 1000; // node processing time before the reply
+    double utilizationLimit = 0.9;
+};
+
+struct PollStats
+{
+    uint64_t runs{};
+    uint64_t failures{};
+    uint64_t missed{};  // finished after the deadline
+    uint64_t skipped{}; // releases dropped because the previous one was too late, counted as missed too
+    std::chrono::microseconds cost{};
+    std::chrono::microseconds maxJitter{};
+    LatencyHistogram::Snapshot jitter; // start - release
+};
+
+// Periodic requests of one bus, earliest deadline first. The bus is not preempted, so a task is admitted
+// while the density of the task set (cost over deadline) plus the longest blocking stays under the limit.
+// The cost is estimated from the wire time first and follows the measured bus time afterwards.
+// Late releases are not caught up: a task that missed whole periods runs once and goes on from now,
+// so no poll is served stale. Owns the Wake object while running.
+class PollScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TaskId = size_t;
+
+    // Throws std::invalid_argument if the baud rate is unknown
+    explicit PollScheduler(Wake& wake, const PollOptions& options = {});
+    PollScheduler(const PollScheduler&) = delete;
+    PollScheduler& operator=(const PollScheduler&) = delete;
+    ~PollScheduler()
+    {
+        Stop();
+    }
+
+    // Empty if the bus can't take the task without missing deadlines. The first release is right away.
+    std::optional<TaskId> AddTask(PollTask task);
+    bool RemoveTask(TaskId id);
+    std::optional<PollStats> GetStats(TaskId id) const;
+    // Bus time share of the admitted tasks
+    double GetUtilization() const;
+    // Transaction time estimate: request and reply on the wire and the node turnaround
+    std::chrono::microseconds GetCost(const Packet_t& request, size_t replySize) const;
+
+    // Serves the tasks on the calling thread until the time point or Stop().
+    // One runner at a time: throws std::logic_error if RunUntil or the Start() thread is serving already.
+    void RunUntil(Clock::time_point until);
+    void Start();
+    // Ends the runs and joins the Start() thread. Handlers may call it, the scheduler thread
+    // then leaves once the handler returns and is joined by the next Start() or the destructor.
+    void Stop();
+private:
+    struct Entry
+    {
+        PollTask task;
+        Clock::time_point release;
+        std::chrono::microseconds cost;
+        PollStats stats;
+        LatencyHistogram jitter;
+    };
+    struct Job
+    {
+        Clock::time_point key; // release while pending, deadline when ready
+        TaskId id;
+        bool operator<(const Job& other) const
+        {
+            return key > other.key; // min-heap
+        }
+    };
+
+    Wake& wake_;
+    PollOptions options_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<TaskId, std::shared_ptr<Entry>> tasks_;
+    std::vector<Job> pending_;
+    std::vector<Job> ready_;
+    TaskId nextId_{1};
+    uint64_t stopCount_{}; // a run ends when Stop() bumps it
+    std::thread thread_;
+    uint64_t threadStopCount_{}; // stopCount_ when thread_ was started
+    bool running_{};             // a runner serves the tasks, Wake isn't shared between threads
+
+    bool Admit(const PollTask& task, std::chrono::microseconds cost) const;
+    // The caller has set running_, Run clears it on return
+    void Run(Clock::time_point until, uint64_t stopCount);
+    void RunJob(std::unique_lock<std::mutex>& lock, TaskId id, const std::shared_ptr<Entry>& entry);
+    static std::chrono::microseconds GetDeadline(const PollTask& task)
+    {
+        return task.deadline.count() ? task.deadline : task.period;
+    }
+};
+
+} // Wk
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <stdint.h>
+
+namespace Wk {
+
+struct RtoConfig
+{
+    std::chrono::microseconds initial{50000}; // until the first reply
+    std::chrono::microseconds min{2000};
+    std::chrono::microseconds max{500000};
+};
+
+// Reply timeout per node address, smoothed RTT and RTT variance as in RFC 6298,
+// doubled after each miss until the next reply
+class RtoEstimator
+{
+public:
+    using Duration = std::chrono::microseconds;
+    static constexpr size_t ADDR_NUMBER = 128;
+    static constexpr Duration GRANULARITY{1000};
+    // a zero initial timeout never reaches max by doubling
+    static constexpr uint8_t MAX_BACKOFF = 16;
+
+    explicit RtoEstimator(const RtoConfig& config = {}) : config_{config}
+    { }
+    Duration GetRto(uint8_t addr) const
+    {
+        const auto& node = nodes_[addr % ADDR_NUMBER];
+        Duration rto = config_.initial;
+        if(node.valid) {
+            rto = std::clamp(node.srtt + std::max(GRANULARITY, 4 * node.rttvar), config_.min, config_.max);
+        }
+        return std::min(rto * (1 << node.backoff), config_.max);
+    }
+    // In ms, rounded up
+    uint32_t GetTimeout(uint8_t addr) const
+    {
+        return static_cast<uint32_t>(std::chrono::ceil<std::chrono::milliseconds>(GetRto(addr)).count());
+    }
+    void AddSample(uint8_t addr, Duration rtt)
+    {
+        auto& node = nodes_[addr % ADDR_NUMBER];
+        if(!node.valid) {
+            node.srtt = rtt;
+            node.rttvar = rtt / 2;
+            node.valid = true;
+        }
+        else {
+            auto delta = node.srtt > rtt ? node.srtt - rtt : rtt - node.srtt;
+            node.rttvar = (3 * node.rttvar + delta) / 4;
+            node.srtt = (7 * node.srtt + rtt) / 8;
+        }
+        node.backoff = 0;
+    }
+    void OnTimeout(uint8_t addr)
+    {
+        auto& node = nodes_[addr % ADDR_NUMBER];
+        if(node.backoff < MAX_BACKOFF && GetRto(addr) < config_.max) {
+            ++node.backoff;
+        }
+    }
+    // Forgets the node, e.g. after its address has changed
+    void Reset(uint8_t addr)
+    {
+        nodes_[addr % ADDR_NUMBER] = {};
+    }
+    void Reset()
+    {
+        nodes_.fill({});
+    }
+    bool HasSamples(uint8_t addr) const
+    {
+        return nodes_[addr % ADDR_NUMBER].valid;
+    }
+    Duration GetSrtt(uint8_t addr) const
+    {
+        return nodes_[addr % ADDR_NUMBER].srtt;
+    }
+    Duration GetRttVar(uint8_t addr) const
+    {
+        return nodes_[addr % ADDR_NUMBER].rttvar;
+    }
+private:
+    struct Node
+    {
+        Duration srtt{};
+        Duration rttvar{};
+        uint8_t backoff{};
+        bool valid{};
+    };
+
+    RtoConfig config_;
+    std::array<Node, ADDR_NUMBER> nodes_{};
+};
+
+} // Wk
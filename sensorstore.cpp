@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sensorstore.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace Wk {
+
+namespace {
+
+constexpr size_t READING_SIZE = 5;
+// Independent accumulators the compiler maps onto vector lanes, float sums are moved to double every block
+constexpr size_t LANES = 16;
+constexpr size_t BLOCK_SIZE = 4096;
+
+struct Partial
+{
+    size_t count{};
+    float min{std::numeric_limits<float>::infinity()};
+    float max{-std::numeric_limits<float>::infinity()};
+    double sum{};
+};
+
+void Accumulate(const float* values, size_t size, Partial& result)
+{
+    float lmin[LANES], lmax[LANES];
+    std::fill_n(lmin, LANES, result.min);
+    std::fill_n(lmax, LANES, result.max);
+    size_t i{};
+    while(i + LANES <= size) {
+        auto blockEnd = std::min(size - size % LANES, i + BLOCK_SIZE);
+        float lsum[LANES]{};
+        for(; i < blockEnd; i += LANES) {
+            for(size_t k{}; k < LANES; ++k) {
+                auto v = values[i + k];
+                lmin[k] = v < lmin[k] ? v : lmin[k];
+                lmax[k] = v > lmax[k] ? v : lmax[k];
+                lsum[k] += v;
+            }
+        }
+        for(size_t k{}; k < LANES; ++k) {
+            result.sum += lsum[k];
+        }
+    }
+    for(; i < size; ++i) {
+        lmin[0] = std::min(lmin[0], values[i]);
+        lmax[0] = std::max(lmax[0], values[i]);
+        result.sum += values[i];
+    }
+    for(size_t k{}; k < LANES; ++k) {
+        result.min = std::min(result.min, lmin[k]);
+        result.max = std::max(result.max, lmax[k]);
+    }
+    result.count += size;
+}
+
+// Same with the samples of other devices masked out, no branches in the loop
+void Accumulate(const float* values, const uint8_t* devices, uint8_t device, size_t size, Partial& result)
+{
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    float lmin[LANES], lmax[LANES];
+    uint32_t lcount[LANES]{};
+    std::fill_n(lmin, LANES, result.min);
+    std::fill_n(lmax, LANES, result.max);
+    size_t i{};
+    while(i + LANES <= size) {
+        auto blockEnd = std::min(size - size % LANES, i + BLOCK_SIZE);
+        float lsum[LANES]{};
+        for(; i < blockEnd; i += LANES) {
+            for(size_t k{}; k < LANES; ++k) {
+                bool match = devices[i + k] == device;
+                auto v = values[i + k];
+                auto vmin = match ? v : inf;
+                auto vmax = match ? v : -inf;
+                lmin[k] = vmin < lmin[k] ? vmin : lmin[k];
+                lmax[k] = vmax > lmax[k] ? vmax : lmax[k];
+                lsum[k] += match ? v : 0.0f;
+                lcount[k] += match;
+            }
+        }
+        for(size_t k{}; k < LANES; ++k) {
+            result.sum += lsum[k];
+        }
+    }
+    for(; i < size; ++i) {
+        if(devices[i] == device) {
+            lmin[0] = std::min(lmin[0], values[i]);
+            lmax[0] = std::max(lmax[0], values[i]);
+            result.sum += values[i];
+            ++result.count;
+        }
+    }
+    for(size_t k{}; k < LANES; ++k) {
+        result.min = std::min(result.min, lmin[k]);
+        result.max = std::max(result.max, lmax[k]);
+        result.count += lcount[k];
+    }
+}
+
+} // namespace
+
+bool DecodeSensorReadings(const Packet_t& packet, std::vector<SensorReading>& readings)
+{
+    if(!packet.n || packet.payload[0] != ERR_NO || (packet.n - 1) % READING_SIZE) {
+        return false;
+    }
+    for(size_t i = 1; i < packet.n; i += READING_SIZE) {
+        auto type = packet.payload[i];
+        if(type >= SEN_TYPES_NUMBER) {
+            return false;
+        }
+        uint32_t bits{};
+        for(size_t k{}; k < 4; ++k) {
+            bits |= static_cast<uint32_t>(packet.payload[i + 1 + k]) << (k * 8);
+        }
+        readings.push_back({SensorType(type), std::bit_cast<float>(bits)});
+    }
+    return true;
+}
+
+SensorStore::SensorStore(size_t memoryBudget) :
+  SensorStore([memoryBudget] {
+      std::array<size_t, SEN_TYPES_NUMBER> budget;
+      budget.fill(memoryBudget / SEN_TYPES_NUMBER);
+      return budget;
+  }())
+{ }
+
+SensorStore::SensorStore(const std::array<size_t, SEN_TYPES_NUMBER>& memoryBudget)
+{
+    bool any{};
+    for(size_t type{}; type < SEN_TYPES_NUMBER; ++type) {
+        columns_[type] = std::make_unique<Column>(memoryBudget[type] / SAMPLE_SIZE);
+        any = any || columns_[type]->capacity;
+    }
+    if(!any) {
+        throw std::invalid_argument("SensorStore: memory budget doesn't fit a sample");
+    }
+}
+
+void SensorStore::Append(SensorType type, uint8_t device, uint64_t timestamp, float value)
+{
+    auto& column = *columns_[type];
+    if(!column.capacity) {
+        return;
+    }
+    std::unique_lock lock{column.mutex};
+    if(column.size) {
+        auto last = column.timestamps[(column.head + column.capacity - 1) % column.capacity];
+        timestamp = std::max(timestamp, last);
+    }
+    column.timestamps[column.head] = timestamp;
+    column.values[column.head] = value;
+    column.devices[column.head] = device;
+    column.head = column.head + 1 == column.capacity ? 0 : column.head + 1;
+    if(column.size < column.capacity) {
+        ++column.size;
+    }
+}
+
+bool SensorStore::Append(const Packet_t& packet, uint64_t timestamp)
+{
+    std::vector<SensorReading> readings;
+    auto result = DecodeSensorReadings(packet, readings);
+    for(auto& reading : readings) {
+        Append(reading.type, packet.addr, timestamp, reading.value);
+    }
+    return result;
+}
+
+size_t SensorStore::GetSize(SensorType type) const
+{
+    auto& column = *columns_[type];
+    std::shared_lock lock{column.mutex};
+    return column.size;
+}
+
+void SensorStore::CheckDevice(int device)
+{
+    if(device < ANY_DEVICE || device > UINT8_MAX) {
+        throw std::invalid_argument("SensorStore: wrong device");
+    }
+}
+
+size_t SensorStore::FindWindow(const Column& column, uint64_t from, uint64_t to, std::array<Range, 2>& ranges)
+{
+    if(!column.size || from >= to) {
+        return 0;
+    }
+    auto start = (column.head + column.capacity - column.size) % column.capacity;
+    auto at = [&](size_t i) {
+        auto pos = start + i;
+        return pos >= column.capacity ? pos - column.capacity : pos;
+    };
+    // the ring is sorted by time from the oldest sample
+    auto lowerBound = [&](uint64_t time) {
+        size_t lo{}, hi = column.size;
+        while(lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            if(column.timestamps[at(mid)] < time) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return lo;
+    };
+    auto first = lowerBound(from);
+    auto count = lowerBound(to) - first;
+    if(!count) {
+        return 0;
+    }
+    auto begin = at(first);
+    if(begin + count <= column.capacity) {
+        ranges[0] = {begin, begin + count};
+        return 1;
+    }
+    ranges[0] = {begin, column.capacity};
+    ranges[1] = {0, begin + count - column.capacity};
+    return 2;
+}
+
+SensorStore::Aggregate SensorStore::GetAggregate(SensorType type, uint64_t from, uint64_t to, int device) const
+{
+    CheckDevice(device);
+    auto& column = *columns_[type];
+    std::shared_lock lock{column.mutex};
+    std::array<Range, 2> ranges;
+    auto rangeCount = FindWindow(column, from, to, ranges);
+    Partial partial;
+    for(size_t i{}; i < rangeCount; ++i) {
+        auto [begin, end] = ranges[i];
+        if(device == ANY_DEVICE) {
+            Accumulate(&column.values[begin], end - begin, partial);
+        }
+        else {
+            Accumulate(&column.values[begin], &column.devices[begin], static_cast<uint8_t>(device), end - begin,
+                       partial);
+        }
+    }
+    if(!partial.count) {
+        return {};
+    }
+    return {partial.count, partial.min, partial.max, partial.sum / static_cast<double>(partial.count)};
+}
+
+std::optional<float> SensorStore::GetPercentile(SensorType type, uint64_t from, uint64_t to, double p,
+                                                int device) const
+{
+    CheckDevice(device);
+    std::vector<float> values;
+    {
+        auto& column = *columns_[type];
+        std::shared_lock lock{column.mutex};
+        std::array<Range, 2> ranges;
+        auto rangeCount = FindWindow(column, from, to, ranges);
+        for(size_t i{}; i < rangeCount; ++i) {
+            auto [begin, end] = ranges[i];
+            if(device == ANY_DEVICE) {
+                values.insert(values.end(), &column.values[begin], &column.values[begin] + (end - begin));
+                continue;
+            }
+            for(auto k = begin; k < end; ++k) {
+                if(column.devices[k] == device) {
+                    values.push_back(column.values[k]);
+                }
+            }
+        }
+    }
+    if(values.empty()) {
+        return std::nullopt;
+    }
+    p = std::clamp(p, 0.0, 1.0);
+    auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(values.size())));
+    auto nth = values.begin() + static_cast<ptrdiff_t>(rank ? rank - 1 : 0);
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+size_t SensorStore::Read(SensorType type, uint64_t from, uint64_t to, std::vector<uint64_t>* timestamps,
+                         std::vector<float>* values, std::vector<uint8_t>* devices) const
+{
+    auto& column = *columns_[type];
+    std::shared_lock lock{column.mutex};
+    std::array<Range, 2> ranges;
+    auto rangeCount = FindWindow(column, from, to, ranges);
+    size_t count{};
+    for(size_t i{}; i < rangeCount; ++i) {
+        auto [begin, end] = ranges[i];
+        if(timestamps) {
+            timestamps->insert(timestamps->end(), &column.timestamps[begin], &column.timestamps[begin] + (end - begin));
+        }
+        if(values) {
+            values->insert(values->end(), &column.values[begin], &column.values[begin] + (end - begin));
+        }
+        if(devices) {
+            devices->insert(devices->end(), &column.devices[begin], &column.devices[begin] + (end - begin));
+        }
+        count += end - begin;
+    }
+    return count;
+}
+
+} // Wk
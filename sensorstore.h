@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wsp32.h"
+#include <array>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+
+namespace Wk {
+
+struct SensorReading
+{
+    SensorType type;
+    float value;
+};
+
+// Sensor reply payload: [err] then [type:1][value:4, IEEE 754 float, little endian] for each sensor.
+// Returns false on an error reply or a malformed payload, the readings decoded before are kept.
+bool DecodeSensorReadings(const Packet_t& packet, std::vector<SensorReading>& readings);
+
+// Readings kept by sensor type in ring buffers of fixed capacity, one column per field,
+// so the aggregation over a window runs over plain float arrays. The oldest samples are overwritten.
+// One writer and any number of readers, a column is locked for the duration of a call.
+class SensorStore
+{
+public:
+    static constexpr size_t SAMPLE_SIZE = sizeof(uint64_t) + sizeof(float) + sizeof(uint8_t);
+    static constexpr int ANY_DEVICE = -1;
+
+    struct Aggregate
+    {
+        size_t count{};
+        float min{};
+        float max{};
+        double mean{};
+    };
+
+    // The budget in bytes is shared equally by the sensor types, all of it is allocated up front.
+    // Throws std::invalid_argument if it doesn't fit one sample of each type.
+    explicit SensorStore(size_t memoryBudget);
+    // Budget per type, a type with 0 isn't stored
+    explicit SensorStore(const std::array<size_t, SEN_TYPES_NUMBER>& memoryBudget);
+
+    // timestamp in ns, a value older than the last one of the type is stored with the last timestamp
+    void Append(SensorType type, uint8_t device, uint64_t timestamp, float value);
+    // All the readings of the reply, see DecodeSensorReadings
+    bool Append(const Packet_t& packet, uint64_t timestamp);
+
+    size_t GetSize(SensorType type) const;
+    size_t GetCapacity(SensorType type) const
+    {
+        return columns_[type]->capacity;
+    }
+    // Samples in [from, to), of one device or of all of them.
+    // Throws std::invalid_argument if device is neither ANY_DEVICE nor a node address byte.
+    Aggregate GetAggregate(SensorType type, uint64_t from, uint64_t to, int device = ANY_DEVICE) const;
+    // Nearest rank, p in [0, 1]
+    std::optional<float> GetPercentile(SensorType type, uint64_t from, uint64_t to, double p,
+                                       int device = ANY_DEVICE) const;
+    // Copies the window out, oldest first
+    size_t Read(SensorType type, uint64_t from, uint64_t to, std::vector<uint64_t>* timestamps,
+                std::vector<float>* values, std::vector<uint8_t>* devices) const;
+private:
+    struct Column
+    {
+        explicit Column(size_t size) : capacity{size}, timestamps(size), values(size), devices(size)
+        { }
+        const size_t capacity;
+        std::vector<uint64_t> timestamps;
+        std::vector<float> values;
+        std::vector<uint8_t> devices;
+        size_t head{}; // next write position
+        size_t size{};
+        mutable std::shared_mutex mutex;
+    };
+    // Contiguous part of the ring, the window spans two of them at most
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    std::array<std::unique_ptr<Column>, SEN_TYPES_NUMBER> columns_;
+
+    static void CheckDevice(int device);
+    // Up to 2 ranges of the window in storage order, the caller holds the lock
+    static size_t FindWindow(const Column& column, uint64_t from, uint64_t to, std::array<Range, 2>& ranges);
+};
+
+} // Wk
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "option_parser.h"
+#include "wakesimulator.h"
+
+#include <csignal>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested;
+
+void OnSignal(int)
+{
+    stopRequested = 1;
+}
+
+void PrintUsage()
+{
+    std::cout << "Wake device simulator on a pseudo-terminal\r\n"
+                 "-n <nodes>\r\n"
+                 "    number of nodes, addresses are assigned from 1 skipping the group range, default: 16\r\n"
+                 "-l <us>\r\n"
+                 "    response latency, default: 500\r\n";
+}
+
+// Exits with the usage on a missing value or one that isn't a 32-bit unsigned number
+uint32_t GetOption(Opts::Parser& parser, const char* key, uint32_t defaultValue)
+{
+    auto [position, values] = parser.Find(key, 1);
+    if(position < 0) {
+        return defaultValue;
+    }
+    if(values.empty()) {
+        PrintUsage();
+        exit(1);
+    }
+    const auto& value = values[0];
+    try {
+        size_t parsed{};
+        auto result = std::stoul(value, &parsed);
+        if(parsed != value.size() || value[0] == '-' || result > UINT32_MAX) {
+            throw std::out_of_range("not a 32-bit unsigned number");
+        }
+        return static_cast<uint32_t>(result);
+    }
+    catch(std::exception& e) {
+        std::cerr << "Value of " << key << " is not valid: " << value << "\r\n";
+        PrintUsage();
+        exit(1);
+    }
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    using std::cout;
+    Opts::Parser parser(argc, argv);
+    if(parser.Find("-h")) {
+        PrintUsage();
+        return 0;
+    }
+    auto nodes = GetOption(parser, "-n", 16);
+    auto latency = std::chrono::microseconds(GetOption(parser, "-l", 500));
+    Wk::Simulator simulator;
+    Wk::Simulator::Node node;
+    node.deviceMask = (1U << Wk::DEV_LED_DRIVER) | (1U << Wk::DEV_SENSOR);
+    node.moduleInfo[Wk::DEV_LED_DRIVER] = 0x01;
+    node.moduleInfo[Wk::DEV_SENSOR] = (1U << Wk::SEN_TEMPERATURE) | (1U << Wk::SEN_HUMIDITY);
+    node.latency = latency;
+    for(uint32_t addr = 1, added = 0; addr < 0x80 && added < nodes; ++addr) {
+        if(simulator.AddNode(static_cast<uint8_t>(addr), node)) {
+            ++added;
+        }
+    }
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    simulator.Start();
+    cout << simulator.GetPortPath() << std::endl;
+    while(!stopRequested) {
+        sleep(1);
+    }
+    simulator.Stop();
+    auto counters = simulator.GetCounters();
+    cout << "\r\nRX frames: " << counters.rxFrames << " TX frames: " << counters.txFrames
+         << " Errors: " << counters.errors << std::endl;
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+
+namespace Utils {
+
+// Lock-free single producer / single consumer ring of Size - 1 elements
+template<typename T, size_t Size>
+class SpscQueue
+{
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "Size must be a power of 2");
+public:
+    bool Push(const T& value)
+    {
+        auto head = head_.load(std::memory_order_relaxed);
+        auto next = (head + 1) & (Size - 1);
+        if(next == tail_.load(std::memory_order_acquire)) {
+            return false; // full
+        }
+        buf_[head] = value;
+        head_.store(next, std::memory_order_release);
+        return true;
+    }
+    bool Pop(T& value)
+    {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if(tail == head_.load(std::memory_order_acquire)) {
+            return false; // empty
+        }
+        value = buf_[tail];
+        tail_.store((tail + 1) & (Size - 1), std::memory_order_release);
+        return true;
+    }
+    bool IsEmpty() const
+    {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+private:
+    alignas(64) std::atomic<size_t> head_{};
+    alignas(64) std::atomic<size_t> tail_{};
+    std::array<T, Size> buf_;
+};
+
+} // Utils
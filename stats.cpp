@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stats.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+namespace Wk {
+
+namespace {
+
+// Exact decimal seconds, a double with the default precision rounds the bucket bounds
+std::string FormatSeconds(uint64_t us)
+{
+    auto fraction = std::to_string(us % 1000000);
+    fraction.insert(0, 6 - fraction.size(), '0');
+    fraction.erase(fraction.find_last_not_of('0') + 1);
+    return std::to_string(us / 1000000) + (fraction.empty() ? "" : "." + fraction);
+}
+
+} // namespace
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const
+{
+    Snapshot snapshot;
+    for(size_t i{}; i < buckets_.size(); ++i) {
+        snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.sumUs = sumUs_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void LatencyHistogram::Reset()
+{
+    for(auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sumUs_.store(0, std::memory_order_relaxed);
+}
+
+void WakeStats::AddDecoded(uint8_t addr, FrameDecoder::Status status)
+{
+    switch(status) {
+        case FrameDecoder::Status::Ok:
+            Add(addr, RX_FRAMES);
+            break;
+        case FrameDecoder::Status::CrcError:
+            Add(addr, CRC_ERRORS);
+            break;
+        case FrameDecoder::Status::StuffError:
+            Add(addr, STUFF_ERRORS);
+            break;
+        case FrameDecoder::Status::SyncError:
+            Add(addr, SYNC_ERRORS);
+            break;
+        case FrameDecoder::Status::FormatError:
+        case FrameDecoder::Status::Overflow:
+            Add(addr, FORMAT_ERRORS);
+            break;
+        default:
+            break;
+    }
+}
+
+WakeStats::Counters WakeStats::GetCounters(uint8_t addr) const
+{
+    Counters result;
+    for(size_t i{}; i < COUNTERS_NUMBER; ++i) {
+        result[i] = counters_[addr % ADDR_NUMBER][i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+WakeStats::Counters WakeStats::GetTotals() const
+{
+    Counters result{};
+    for(size_t addr{}; addr < ADDR_NUMBER; ++addr) {
+        auto counters = GetCounters(static_cast<uint8_t>(addr));
+        for(size_t i{}; i < COUNTERS_NUMBER; ++i) {
+            result[i] += counters[i];
+        }
+    }
+    return result;
+}
+
+void WakeStats::Reset()
+{
+    for(auto& counters : counters_) {
+        for(auto& counter : counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+    for(auto& histogram : latency_) {
+        histogram.Reset();
+    }
+}
+
+const char* WakeStats::GetCounterName(Counter counter)
+{
+    switch(counter) {
+        case TX_FRAMES:
+            return "tx_frames";
+        case TX_BYTES:
+            return "tx_bytes";
+        case TX_ERRORS:
+            return "tx_errors";
+        case RX_FRAMES:
+            return "rx_frames";
+        case RX_BYTES:
+            return "rx_bytes";
+        case SYNC_ERRORS:
+            return "sync_errors";
+        case STUFF_ERRORS:
+            return "stuff_errors";
+        case CRC_ERRORS:
+            return "crc_errors";
+        case FORMAT_ERRORS:
+            return "format_errors";
+        case TIMEOUTS:
+            return "timeouts";
+        default:
+            return "unknown";
+    }
+}
+
+void WritePrometheus(std::ostream& os, const std::vector<std::pair<std::string, const WakeStats*>>& buses)
+{
+    // one snapshot per bus, so all the families show the same moment
+    std::vector<std::array<WakeStats::Counters, WakeStats::ADDR_NUMBER>> counters(buses.size());
+    for(size_t bus{}; bus < buses.size(); ++bus) {
+        for(size_t addr{}; addr < WakeStats::ADDR_NUMBER; ++addr) {
+            counters[bus][addr] = buses[bus].second->GetCounters(static_cast<uint8_t>(addr));
+        }
+    }
+    for(size_t i{}; i < WakeStats::COUNTERS_NUMBER; ++i) {
+        auto name = WakeStats::GetCounterName(WakeStats::Counter(i));
+        os << "# TYPE wake_" << name << "_total counter\n";
+        for(size_t bus{}; bus < buses.size(); ++bus) {
+            for(size_t addr{}; addr < WakeStats::ADDR_NUMBER; ++addr) {
+                const auto& values = counters[bus][addr];
+                bool idle = true;
+                for(auto value : values) {
+                    idle = idle && !value;
+                }
+                if(!idle) {
+                    os << "wake_" << name << "_total{bus=\"" << buses[bus].first << "\",addr=\"" << addr << "\"} "
+                       << values[i] << '\n';
+                }
+            }
+        }
+    }
+    os << "# TYPE wake_request_duration_seconds histogram\n";
+    for(const auto& [busName, stats] : buses) {
+        for(size_t cmd{}; cmd < WakeStats::CMD_NUMBER; ++cmd) {
+            auto latency = stats->GetLatency(static_cast<uint8_t>(cmd));
+            if(!latency.count) {
+                continue;
+            }
+            auto labels = "bus=\"" + busName + "\",cmd=\"" + std::to_string(cmd) + "\"";
+            uint64_t cumulative{};
+            for(size_t i{}; i < LatencyHistogram::BOUNDS_NUMBER; ++i) {
+                cumulative += latency.buckets[i];
+                os << "wake_request_duration_seconds_bucket{" << labels << ",le=\""
+                   << FormatSeconds(LatencyHistogram::FIRST_BOUND_US << i) << "\"} " << cumulative << '\n';
+            }
+            os << "wake_request_duration_seconds_bucket{" << labels << ",le=\"+Inf\"} " << latency.count << '\n';
+            os << "wake_request_duration_seconds_sum{" << labels << "} " << FormatSeconds(latency.sumUs) << '\n';
+            os << "wake_request_duration_seconds_count{" << labels << "} " << latency.count << '\n';
+        }
+    }
+}
+
+bool StatsExporter::Export()
+{
+    std::ostringstream os;
+    WritePrometheus(os, buses_);
+    auto text = os.str();
+    bool result = true;
+    if(!path_.empty()) {
+        auto tmpPath = path_ + ".tmp";
+        {
+            std::ofstream file{tmpPath, std::ios::trunc};
+            file << text;
+            result = file.good();
+        }
+        result = result && !rename(tmpPath.c_str(), path_.c_str());
+    }
+    if(callback_) {
+        callback_(text);
+    }
+    return result;
+}
+
+void StatsExporter::Start()
+{
+    if(thread_.joinable()) {
+        return;
+    }
+    stop_ = false;
+    thread_ = std::thread{[this] {
+        std::unique_lock lock{mutex_};
+        while(!cv_.wait_for(lock, period_, [this] { return stop_; })) {
+            lock.unlock();
+            Export();
+            lock.lock();
+        }
+    }};
+}
+
+void StatsExporter::Stop()
+{
+    if(!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+} // Wk
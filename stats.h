@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "wakecodec.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Wk {
+
+// Request latency, bucket i counts the values up to FIRST_BOUND_US << i, the last one the rest
+class LatencyHistogram
+{
+public:
+    static constexpr size_t BOUNDS_NUMBER = 16;
+    static constexpr uint64_t FIRST_BOUND_US = 64;
+
+    struct Snapshot
+    {
+        std::array<uint64_t, BOUNDS_NUMBER + 1> buckets{};
+        uint64_t count{};
+        uint64_t sumUs{};
+    };
+
+    void Add(std::chrono::microseconds latency)
+    {
+        auto us = static_cast<uint64_t>(latency.count());
+        size_t i{};
+        while(i < BOUNDS_NUMBER && us > FIRST_BOUND_US << i) {
+            ++i;
+        }
+        buckets_[i].fetch_add(1, std::memory_order_relaxed);
+        sumUs_.fetch_add(us, std::memory_order_relaxed);
+    }
+    Snapshot GetSnapshot() const;
+    void Reset();
+private:
+    std::array<std::atomic<uint64_t>, BOUNDS_NUMBER + 1> buckets_{};
+    std::atomic<uint64_t> sumUs_{};
+};
+
+// Always-on protocol counters of one bus, per node address, and latency per command.
+// Updated by the thread doing the I/O, read from any thread; relaxed atomics, no locks.
+class WakeStats
+{
+public:
+    enum Counter {
+        TX_FRAMES,
+        TX_BYTES,
+        TX_ERRORS,
+        RX_FRAMES,
+        RX_BYTES,
+        SYNC_ERRORS,
+        STUFF_ERRORS,
+        CRC_ERRORS,
+        FORMAT_ERRORS, // bad header, overflow or a frame cut short
+        TIMEOUTS,
+        COUNTERS_NUMBER
+    };
+    static constexpr size_t ADDR_NUMBER = 128;
+    static constexpr size_t CMD_NUMBER = 256;
+    using Counters = std::array<uint64_t, COUNTERS_NUMBER>;
+
+    void Add(uint8_t addr, Counter counter, uint64_t value = 1)
+    {
+        counters_[addr % ADDR_NUMBER][counter].fetch_add(value, std::memory_order_relaxed);
+    }
+    // Counts the frame or the error the decoder reported
+    void AddDecoded(uint8_t addr, FrameDecoder::Status status);
+    void AddLatency(uint8_t cmd, std::chrono::microseconds latency)
+    {
+        latency_[cmd].Add(latency);
+    }
+    Counters GetCounters(uint8_t addr) const;
+    // Sum over the addresses
+    Counters GetTotals() const;
+    LatencyHistogram::Snapshot GetLatency(uint8_t cmd) const
+    {
+        return latency_[cmd].GetSnapshot();
+    }
+    void Reset();
+
+    static const char* GetCounterName(Counter counter);
+private:
+    std::array<std::array<std::atomic<uint64_t>, COUNTERS_NUMBER>, ADDR_NUMBER> counters_{};
+    std::array<LatencyHistogram, CMD_NUMBER> latency_{};
+};
+
+// Prometheus text format, one bus label per stats object. Idle addresses and commands are left out.
+void WritePrometheus(std::ostream& os, const std::vector<std::pair<std::string, const WakeStats*>>& buses);
+
+// Dumps the stats of the buses periodically from its own thread
+class StatsExporter
+{
+public:
+    using Callback = std::function<void(const std::string& text)>;
+
+    explicit StatsExporter(std::chrono::milliseconds period) : period_{period}
+    { }
+    StatsExporter(const StatsExporter&) = delete;
+    StatsExporter& operator=(const StatsExporter&) = delete;
+    ~StatsExporter()
+    {
+        Stop();
+    }
+    // Must not be called while running, the stats object must outlive the exporter
+    void AddBus(const std::string& name, const WakeStats& stats)
+    {
+        buses_.emplace_back(name, &stats);
+    }
+    // Written to a temporary file and renamed, as the node exporter textfile collector expects
+    void SetFile(const std::string& path)
+    {
+        path_ = path;
+    }
+    void SetCallback(Callback callback)
+    {
+        callback_ = std::move(callback);
+    }
+    // Formats the current snapshot and hands it to the file and the callback
+    bool Export();
+    void Start();
+    void Stop();
+private:
+    std::chrono::milliseconds period_;
+    std::vector<std::pair<std::string, const WakeStats*>> buses_;
+    std::string path_;
+    Callback callback_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_{};
+};
+
+} // Wk
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bulktransfer.h"
+#include "serialport.h"
+#include "test.h"
+#include "wakesimulator.h"
+
+namespace Test {
+
+using namespace Wk;
+
+constexpr uint8_t NODE_ADDR = 9;
+
+// Every 7th data frame is lost, the image is mostly bytes that have to be escaped
+static void SendLossy(bool ackEach)
+{
+    Simulator sim;
+    Simulator::Node node;
+    node.bulkDropInterval = 7;
+    sim.AddNode(NODE_ADDR, node);
+    sim.Start();
+    SerialPort port(sim.GetPortPath(), 115200);
+    Wake wake(port);
+    CHECK(wake.OpenConnection());
+    std::vector<uint8_t> image(4000);
+    for(size_t i{}; i < image.size(); ++i) {
+        image[i] = i % 3 == 0 ? 0xC0 : i % 3 == 1 ? 0xDB : static_cast<uint8_t>(i);
+    }
+    BulkOptions options;
+    options.ackEach = ackEach;
+    auto report = SendImage(wake, NODE_ADDR, image, options);
+    CHECK(report.status == BulkStatus::Ok);
+    CHECK(report.retransmits > 0);
+    CHECK(sim.GetNode(NODE_ADDR, node) && node.image == image);
+}
+
+void RunBulkTransfer()
+{
+    SendLossy(false);
+    SendLossy(true);
+}
+
+} // Test
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "coro.h"
+#include "serialport.h"
+#include "test.h"
+#include "wakesimulator.h"
+
+namespace Test {
+
+using namespace Wk;
+
+constexpr uint8_t NODE_ADDR = 5;
+constexpr uint8_t MISSING_ADDR = 6;
+
+static Task<Reply> Echo(AsyncBus bus, uint8_t addr, uint32_t timeout)
+{
+    static const uint8_t data[] = {1, 2, 3};
+    co_return co_await bus.RequestAsync(PacketView{addr, C_ECHO, data}, timeout);
+}
+
+static bool IsEcho(const Reply& reply)
+{
+    const auto& packet = reply.packet;
+    return reply.status == RequestStatus::Ok && packet.addr == NODE_ADDR && packet.n == 3 && packet.payload[0] == 1 &&
+           packet.payload[2] == 3;
+}
+
+// Runs alongside the task driven by RunUntilComplete
+static Task<> Dialog(AsyncBus bus, bool& done)
+{
+    co_await bus.Sleep(5);
+    auto reply = co_await Echo(bus, NODE_ADDR, 100);
+    CHECK(IsEcho(reply));
+    done = true;
+}
+
+static Task<AsyncEngine::Clock::duration> TimeSleep(AsyncBus bus, uint32_t delay)
+{
+    auto start = AsyncEngine::Clock::now();
+    co_await bus.Sleep(delay);
+    co_return AsyncEngine::Clock::now() - start;
+}
+
+static Task<> WaitFor(AsyncBus bus, const bool& done)
+{
+    while(!done) {
+        co_await bus.Sleep(1);
+    }
+}
+
+// Awaits again after the cancellation, the second request must not be lost
+static Task<> Retry(AsyncBus bus, RequestStatus& first, RequestStatus& second, bool& done)
+{
+    first = (co_await Echo(bus, NODE_ADDR, 100)).status;
+    second = (co_await Echo(bus, NODE_ADDR, 100)).status;
+    done = true;
+}
+
+static void CancelOnDestruction()
+{
+    Simulator sim;
+    sim.AddNode(NODE_ADDR, {});
+    sim.Start();
+    SerialPort port(sim.GetPortPath(), 115200);
+    CHECK(port.OpenCOM());
+    RequestStatus first{}, second{};
+    bool done{};
+    {
+        AsyncEngine engine;
+        AsyncBus bus(engine, engine.AddBus(port));
+        Spawn(Retry(bus, first, second, done));
+    }
+    CHECK(done && first == RequestStatus::Cancelled && second == RequestStatus::Cancelled);
+}
+
+void RunCoro()
+{
+    CancelOnDestruction();
+
+    Simulator sim;
+    sim.AddNode(NODE_ADDR, {});
+    sim.Start();
+    SerialPort port(sim.GetPortPath(), 115200);
+    CHECK(port.OpenCOM());
+    AsyncEngine engine;
+    AsyncBus bus(engine, engine.AddBus(port));
+
+    bool spawnedDone{};
+    Spawn(Dialog(bus, spawnedDone));
+    CHECK(!spawnedDone);
+
+    CHECK(IsEcho(RunUntilComplete(engine, Echo(bus, NODE_ADDR, 100))));
+    CHECK(RunUntilComplete(engine, Echo(bus, MISSING_ADDR, 20)).status == RequestStatus::Timeout);
+    CHECK(RunUntilComplete(engine, TimeSleep(bus, 10)) >= std::chrono::milliseconds(10));
+    RunUntilComplete(engine, WaitFor(bus, spawnedDone));
+    CHECK(spawnedDone);
+}
+
+} // Test
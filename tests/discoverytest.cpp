@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "discovery.h"
+#include "serialport.h"
+#include "test.h"
+#include "wakesimulator.h"
+
+namespace Test {
+
+using namespace Wk;
+
+// A reply slower than the probe timeout lands in the next probe, it must not
+// make the silent address next to the slow node look alive
+static void ScanSlowNode()
+{
+    ScanOptions options;
+    options.firstAddr = 5;
+    options.lastAddr = 8;
+    Simulator sim;
+    Simulator::Node slow, fast;
+    // stock USB adapters deliver the reply after their latency timer
+    CHECK(GetReplyTimeout(115200, 5, options.turnaroundUs, options.adapterLatencyUs) > 16);
+    // the pty delivers at once
+    options.adapterLatencyUs = 0;
+    auto timeout = GetReplyTimeout(115200, 5, options.turnaroundUs);
+    slow.latency = std::chrono::milliseconds(timeout) + std::chrono::microseconds(500);
+    sim.AddNode(5, slow);
+    sim.AddNode(8, fast);
+    sim.Start();
+    SerialPort port(sim.GetPortPath(), 115200);
+    Wake wake(port);
+    CHECK(wake.OpenConnection());
+    auto topology = ScanBus(wake, options);
+    CHECK(!topology.nodes.count(6));
+    CHECK(!topology.nodes.count(7));
+    CHECK(topology.nodes.count(8));
+    Packet_t packet{8, C_ECHO, {1, 2}};
+    CHECK(wake.Request(packet) && packet.addr == 8 && packet.n == 2);
+}
+
+void RunDiscovery()
+{
+    ScanSlowNode();
+}
+
+} // Test
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "framelog.h"
+#include "test.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace Test {
+
+using namespace Wk;
+
+static std::vector<uint8_t> ReadFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+const std::string LOG_PATH = "framelogtest.bin";
+
+// count records over 4 addresses and 2 commands, 10 ns apart but the 6th, which is stale
+static void WriteLog(FrameLog::Writer& writer, size_t count, bool close, uint8_t n = 1)
+{
+    CHECK(writer.Open(LOG_PATH));
+    Packet_t packet{};
+    packet.n = n;
+    for(size_t i = 0; i < count; ++i) {
+        packet.addr = i % 4;
+        packet.cmd = 6 + i % 2;
+        packet.payload[0] = uint8_t(i);
+        // the stale timestamp is stored as the last one
+        CHECK(writer.Append(i == 5 ? 0 : i * 10, 0, packet, true, FrameLog::Direction::Rx));
+    }
+    CHECK(close ? writer.Close() : writer.Flush());
+}
+
+static void RemoveLog()
+{
+    remove(LOG_PATH.c_str());
+    remove((LOG_PATH + ".idx").c_str());
+}
+
+static void CheckQueries(const FrameLog::Reader& reader, size_t count)
+{
+    CHECK(reader.GetCount() == count);
+    CHECK(reader.Get(5).timestamp == 40);
+    CHECK(reader.LowerBound(41) == 6);
+    size_t found{};
+    reader.ForEachByAddress(1, 0, UINT64_MAX, [&](const FrameLog::Record& record) {
+        CHECK(record.addr == 1 && record.n && record.payload[0] == found * 4 + 1);
+        ++found;
+    });
+    CHECK(found == (count + 2) / 4);
+    found = 0;
+    reader.ForEachByCommand(7, 20, 50, [&](const FrameLog::Record& record) {
+        CHECK(record.cmd == 7 && record.timestamp >= 20 && record.timestamp < 50);
+        ++found;
+    });
+    CHECK(found == 2);
+}
+
+// A log that wasn't closed has no sections, short ones must open as well
+static void ReopenUnclosed(size_t count)
+{
+    // the writer stays open while the log is read
+    FrameLog::Writer writer;
+    WriteLog(writer, count, false);
+    auto log = ReadFile(LOG_PATH);
+    auto index = ReadFile(LOG_PATH + ".idx");
+    FrameLog::Reader reader(log.data(), log.size(), index.data(), index.size());
+    CHECK(reader.GetByAddress(1).second == 0);
+    CheckQueries(reader, count);
+    RemoveLog();
+}
+
+// The sections of a closed log serve the address and command queries
+static void ReopenClosed()
+{
+    FrameLog::Writer writer;
+    WriteLog(writer, 60, true);
+    auto log = ReadFile(LOG_PATH);
+    auto index = ReadFile(LOG_PATH + ".idx");
+    FrameLog::Reader reader(log.data(), log.size(), index.data(), index.size());
+    auto [records, size] = reader.GetByAddress(2);
+    CHECK(records && size == 15);
+    for(size_t i{}; records && i < size; ++i) {
+        CHECK(records[i] == i * 4 + 2);
+    }
+    CHECK(reader.GetByCommand(7).second == 30 && reader.GetByCommand(8).second == 0);
+    CheckQueries(reader, 60);
+    RemoveLog();
+}
+
+// A crash may leave the last record cut in the payload or in the header, it's dropped.
+// A closed index still lists it in the sections, the queries must not reach it.
+static void ReopenCut(bool close)
+{
+    constexpr uint8_t n = 20;
+    FrameLog::Writer writer;
+    WriteLog(writer, 10, close, n);
+    auto log = ReadFile(LOG_PATH);
+    auto index = ReadFile(LOG_PATH + ".idx");
+    for(size_t cut : {size_t{1}, size_t{n}, n + sizeof(FrameLog::RecordHeader) - 1}) {
+        std::vector<uint8_t> head(log.begin(), log.end() - static_cast<ptrdiff_t>(cut));
+        FrameLog::Reader reader(head.data(), head.size(), index.data(), index.size());
+        CHECK(reader.GetCount() == 9);
+        auto last = reader.Get(reader.GetCount() - 1);
+        CHECK(last.payload + last.n <= head.data() + head.size());
+        size_t found{};
+        reader.ForEachByAddress(1, 0, UINT64_MAX, [&](const FrameLog::Record& record) {
+            CHECK(record.payload + record.n <= head.data() + head.size());
+            ++found;
+        });
+        CHECK(found == 2);
+    }
+    FrameLog::Reader reader(log.data(), log.size(), index.data(), index.size());
+    CHECK(reader.GetCount() == 10);
+    RemoveLog();
+}
+
+// Group bounds out of order or past the record count are refused
+static void RejectCorruptSections()
+{
+    FrameLog::Writer writer;
+    WriteLog(writer, 10, true);
+    auto log = ReadFile(LOG_PATH);
+    auto index = ReadFile(LOG_PATH + ".idx");
+    FrameLog::IndexHeader header;
+    memcpy(&header, index.data(), sizeof(header));
+    for(uint64_t start : {uint64_t{11}, uint64_t{0}}) {
+        auto corrupt = index;
+        // the bound after the group of address 1
+        memcpy(corrupt.data() + header.addrSection + 2 * sizeof(uint64_t), &start, sizeof(start));
+        bool thrown{};
+        try {
+            FrameLog::Reader reader(log.data(), log.size(), corrupt.data(), corrupt.size());
+        }
+        catch(const std::invalid_argument&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    RemoveLog();
+}
+
+void RunFrameLog()
+{
+    ReopenUnclosed(10);
+    ReopenUnclosed(60);
+    ReopenClosed();
+    ReopenCut(false);
+    ReopenCut(true);
+    RejectCorruptSections();
+}
+
+} // Test
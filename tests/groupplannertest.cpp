@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "groupplanner.h"
+#include "serialport.h"
+#include "test.h"
+#include "wakesimulator.h"
+#include <unistd.h>
+
+namespace Test {
+
+using namespace Wk;
+
+// Loses every frame
+struct DeadPort : ISerialPort
+{
+    bool AccessCOM() override
+    {
+        return false;
+    }
+    bool OpenCOM() override
+    {
+        return true;
+    }
+    bool CloseCOM() override
+    {
+        return true;
+    }
+    bool WriteData(const uint8_t*, uint32_t) override
+    {
+        return false;
+    }
+    bool ReadData(uint8_t*, uint32_t) override
+    {
+        return false;
+    }
+    bool ResetStatus() override
+    {
+        return true;
+    }
+    bool Flush() override
+    {
+        return true;
+    }
+    bool SetTimeout(uint32_t) override
+    {
+        return true;
+    }
+};
+
+// The members of a group frame that couldn't be sent are reported as failed
+static void ReportTxError()
+{
+    DeadPort port;
+    Wake wake(port);
+    GroupPlanner planner(wake, {0, true, 0, 20});
+    planner.SetGroup(1, ADDR_GROUP_MIN);
+    planner.SetGroup(2, ADDR_GROUP_MIN);
+    const uint8_t nodes[] = {1, 2};
+    auto report = planner.Execute(nodes, C_ON);
+    CHECK(report.groupFrames == 0 && report.failed == std::vector<uint8_t>({1, 2}));
+}
+
+void RunGroupPlanner()
+{
+    ReportTxError();
+
+    Simulator sim;
+    for(uint8_t addr = 1; addr <= GroupPlanner::GROUP_NUMBER; ++addr) {
+        Simulator::Node node;
+        node.groupAddr = static_cast<uint8_t>(ADDR_GROUP_MIN + addr - 1);
+        sim.AddNode(addr, node);
+    }
+    sim.AddNode(30, {});
+    sim.AddNode(31, {});
+    sim.Start();
+    SerialPort port(sim.GetPortPath(), 115200);
+    Wake wake(port);
+    CHECK(wake.OpenConnection());
+    GroupPlanner planner(wake, {0, false, 0, 20});
+    for(uint8_t addr = 1; addr <= GroupPlanner::GROUP_NUMBER; ++addr) {
+        planner.SetGroup(addr, static_cast<uint8_t>(ADDR_GROUP_MIN + addr - 1));
+    }
+
+    // nothing left over, no group is evicted even with all of them in use
+    const uint8_t first[] = {1};
+    auto report = planner.Execute(first, C_ON);
+    CHECK(report.groupFrames == 1 && report.unicastRequests == 0);
+    CHECK(planner.GetGroup(2) == ADDR_GROUP_MIN + 1);
+    // no wrapping onto node 2
+    CHECK(planner.GetGroup(130) == 0);
+
+    // a node out of reach doesn't confirm leaving the group, it's still counted as a member
+    const uint8_t lost[] = {30, 31, 40};
+    report = planner.Execute(lost, C_ON);
+    CHECK(report.failed.size() == 1 && report.failed[0] == 40);
+    CHECK(planner.GetGroup(40) && planner.GetGroup(40) == planner.GetGroup(30));
+    usleep(20000);
+    Simulator::Node node;
+    CHECK(sim.GetNode(31, node) && node.on && node.groupAddr == planner.GetGroup(31));
+}
+
+} // Test
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pollscheduler.h"
+#include "serialport.h"
+#include "test.h"
+#include "wakesimulator.h"
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace Test {
+
+using namespace Wk;
+using namespace std::chrono_literals;
+
+static PollTask MakeTask(uint8_t addr, std::chrono::microseconds period, std::chrono::microseconds deadline = {})
+{
+    PollTask task;
+    task.request = Packet_t{addr, C_ECHO, {}};
+    task.period = period;
+    task.deadline = deadline;
+    task.replySize = 0;
+    return task;
+}
+
+// A task costlier than its deadline is refused, so is one that would overload the bus
+static void Admission(Wake& wake)
+{
+    PollScheduler scheduler(wake);
+    auto cost = scheduler.GetCost(Packet_t{1, C_ECHO, {}}, 0);
+    CHECK(!scheduler.AddTask(MakeTask(1, cost / 2)));
+    // density 1/3 and as much blocking
+    CHECK(scheduler.AddTask(MakeTask(1, cost * 3)));
+    CHECK(!scheduler.AddTask(MakeTask(2, cost * 3)));
+    CHECK(scheduler.GetUtilization() > 0.3 && scheduler.GetUtilization() < 0.4);
+}
+
+// Released together, the task with the earlier deadline goes first whatever the order they were added in
+static void EdfOrder(Wake& wake)
+{
+    PollScheduler scheduler(wake);
+    std::vector<uint8_t> order;
+    for(uint8_t addr : {1, 2, 3}) {
+        auto task = MakeTask(addr, 200ms, std::chrono::milliseconds(150 - addr * 40));
+        task.handler = [&order](RequestStatus status, const Packet_t& reply) {
+            CHECK(status == RequestStatus::Ok);
+            order.push_back(reply.addr);
+        };
+        CHECK(scheduler.AddTask(std::move(task)));
+    }
+    scheduler.RunUntil(PollScheduler::Clock::now() + 50ms);
+    CHECK(order == std::vector<uint8_t>({3, 2, 1}));
+}
+
+// A handler that overstays whole periods delays the next release, the periods it covered are skipped
+// and counted as missed, not caught up
+static void SkipLate(Wake& wake)
+{
+    PollScheduler scheduler(wake);
+    size_t runs{};
+    auto task = MakeTask(1, 10ms);
+    task.handler = [&runs](RequestStatus, const Packet_t&) {
+        if(!runs++) {
+            std::this_thread::sleep_for(35ms);
+        }
+    };
+    auto id = scheduler.AddTask(std::move(task));
+    CHECK(id);
+    scheduler.RunUntil(PollScheduler::Clock::now() + 45ms);
+    auto stats = scheduler.GetStats(*id);
+    CHECK(stats && stats->runs == runs && stats->failures == 0);
+    CHECK(stats && stats->skipped >= 2 && stats->missed >= stats->skipped);
+    // no stale polls: 45 ms hold 4 releases at most after the late one
+    CHECK(runs >= 2 && runs <= 5);
+}
+
+// The Start() thread and RunUntil can't both talk to the port
+static void SingleRunner(Wake& wake)
+{
+    PollScheduler scheduler(wake);
+    CHECK(scheduler.AddTask(MakeTask(1, 20ms)));
+    scheduler.Start();
+    bool thrown{};
+    try {
+        scheduler.RunUntil(PollScheduler::Clock::now() + 10ms);
+    }
+    catch(const std::logic_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    scheduler.Stop();
+    scheduler.RunUntil(PollScheduler::Clock::now() + 10ms);
+}
+
+void RunPollScheduler()
+{
+    Simulator sim;
+    sim.AddNode(1, {});
+    sim.AddNode(2, {});
+    sim.AddNode(3, {});
+    sim.Start();
+    SerialPort port(sim.GetPortPath(), 115200);
+    Wake wake(port);
+    CHECK(wake.OpenConnection());
+    Admission(wake);
+    EdfOrder(wake);
+    SkipLate(wake);
+    SingleRunner(wake);
+}
+
+} // Test
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sensorstore.h"
+#include "test.h"
+#include <stdexcept>
+
+namespace Test {
+
+using namespace Wk;
+
+// The ring of 100 samples holds 150..249 after 250 appends, [160, 240) wraps around its end:
+// 40 samples at the tail of the storage and 40 at the head, both long enough for the lane loops
+static void AggregateWrapped()
+{
+    std::array<size_t, SEN_TYPES_NUMBER> budget{};
+    budget[SEN_TEMPERATURE] = 100 * SensorStore::SAMPLE_SIZE;
+    SensorStore store(budget);
+    for(uint64_t i{}; i < 250; ++i) {
+        store.Append(SEN_TEMPERATURE, static_cast<uint8_t>(i % 3), i, static_cast<float>(i));
+    }
+    CHECK(store.GetSize(SEN_TEMPERATURE) == 100);
+
+    auto all = store.GetAggregate(SEN_TEMPERATURE, 160, 240);
+    CHECK(all.count == 80 && all.min == 160 && all.max == 239 && all.mean == 199.5);
+    // 160, 163 .. 238
+    auto one = store.GetAggregate(SEN_TEMPERATURE, 160, 240, 1);
+    CHECK(one.count == 27 && one.min == 160 && one.max == 238 && one.mean == 199);
+    CHECK(store.GetAggregate(SEN_TEMPERATURE, 0, 150).count == 0);
+
+    // nearest rank: ceil(p * count)-th smallest
+    CHECK(store.GetPercentile(SEN_TEMPERATURE, 160, 240, 0.5) == 199.0f);
+    CHECK(store.GetPercentile(SEN_TEMPERATURE, 160, 240, 0) == 160.0f);
+    CHECK(store.GetPercentile(SEN_TEMPERATURE, 160, 240, 1) == 239.0f);
+    CHECK(store.GetPercentile(SEN_TEMPERATURE, 160, 240, 0.5, 1) == 199.0f);
+    CHECK(!store.GetPercentile(SEN_TEMPERATURE, 250, 300, 0.5));
+
+    std::vector<uint64_t> timestamps;
+    CHECK(store.Read(SEN_TEMPERATURE, 160, 240, &timestamps, nullptr, nullptr) == 80);
+    CHECK(timestamps.front() == 160 && timestamps.back() == 239);
+}
+
+// Both queries refuse a device filter that isn't a byte, instead of truncating it or matching nothing
+static void RejectDevice()
+{
+    SensorStore store(SEN_TYPES_NUMBER * SensorStore::SAMPLE_SIZE);
+    store.Append(SEN_TEMPERATURE, 0, 1, 20.0f);
+    size_t thrown{};
+    for(int device : {256, -2}) {
+        try {
+            store.GetAggregate(SEN_TEMPERATURE, 0, 10, device);
+        }
+        catch(const std::invalid_argument&) {
+            ++thrown;
+        }
+        try {
+            store.GetPercentile(SEN_TEMPERATURE, 0, 10, 0.5, device);
+        }
+        catch(const std::invalid_argument&) {
+            ++thrown;
+        }
+    }
+    CHECK(thrown == 4);
+    CHECK(store.GetAggregate(SEN_TEMPERATURE, 0, 10, 0).count == 1);
+}
+
+void RunSensorStore()
+{
+    AggregateWrapped();
+    RejectDevice();
+}
+
+} // Test
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <iostream>
+
+namespace Test {
+
+inline int failures;
+
+// Reports the failed condition and goes on with the test
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if(!(cond)) {                                                                   \
+            ++Test::failures;                                                           \
+            std::cout << __FILE__ << ':' << __LINE__ << ": CHECK(" #cond ") failed\r\n"; \
+        }                                                                               \
+    } while(0)
+
+void RunFrameLog();
+void RunBulkTransfer();
+void RunCoro();
+void RunDiscovery();
+void RunGroupPlanner();
+void RunPollScheduler();
+void RunSensorStore();
+
+} // Test
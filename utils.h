@@ -22,7 +22,9 @@
 
 #pragma once
 
+#include <iostream>
 #include <stdint.h>
+#include <string>
 
 namespace Utils {
 constexpr static uint16_t htons(uint16_t val)
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "wakecodec.h"
+#include <string.h>
+
+namespace Wk {
+
+namespace {
+
+const uint8_t escapedFend[2] = {FESC, TFEND};
+const uint8_t escapedFesc[2] = {FESC, TFESC};
+
+inline size_t Header(uint8_t addr, uint8_t cmd, uint8_t n, uint8_t* header)
+{
+    size_t size{};
+    header[size++] = FEND;
+    if(addr) {
+        header[size++] = addr | 0x80;
+    }
+    header[size++] = cmd;
+    header[size++] = n;
+    return size;
+}
+
+} // namespace
+
+size_t FindEscape(const uint8_t* data, size_t size)
+{
+    size_t i{};
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // A byte of (w ^ pattern) is zero where w matches. The lowest flagged byte of the classic
+    // has-zero test is exact, borrows may only flag the bytes above it.
+    constexpr uint64_t ONES = 0x0101010101010101ULL;
+    constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, data + i, sizeof(w));
+        auto fend = w ^ (ONES * FEND);
+        auto fesc = w ^ (ONES * FESC);
+        auto mask = ((fend - ONES) & ~fend & HIGHS) | ((fesc - ONES) & ~fesc & HIGHS);
+        if(mask) {
+            return i + (__builtin_ctzll(mask) >> 3);
+        }
+    }
+#endif
+    for(; i < size; ++i) {
+        if(data[i] == FEND || data[i] == FESC) {
+            break;
+        }
+    }
+    return i;
+}
+
+size_t Stuff(const uint8_t* src, size_t size, uint8_t* dst)
+{
+    size_t j{};
+    while(size) {
+        auto run = FindEscape(src, size);
+        memcpy(dst + j, src, run);
+        j += run;
+        if(run == size) {
+            break;
+        }
+        dst[j++] = FESC;
+        dst[j++] = src[run] == FEND ? TFEND : TFESC;
+        src += run + 1;
+        size -= run + 1;
+    }
+    return j;
+}
+
+size_t EncodeFrame(uint8_t addr, uint8_t cmd, uint8_t n, const uint8_t* data, uint8_t* buf, uint8_t& crc)
+{
+    uint8_t header[4];
+    auto headerSize = Header(addr, cmd, n, header);
+    Mcudrv::Crc::Crc8 txCrc(CRC_INIT);
+    crc = txCrc(header, headerSize)(data, n).GetResult();
+    size_t j = 1;
+    buf[0] = FEND;
+    j += Stuff(header + 1, headerSize - 1, buf + j);
+    j += Stuff(data, n, buf + j);
+    j += Stuff(&crc, 1, buf + j);
+    return j;
+}
+
+size_t FrameEncoder::Encode(uint8_t addr, uint8_t cmd, uint8_t n, const uint8_t* data)
+{
+    count_ = size_ = 0;
+    uint8_t header[4];
+    auto headerSize = Header(addr, cmd, n, header);
+    Mcudrv::Crc::Crc8 txCrc(CRC_INIT);
+    crc_ = txCrc(header, headerSize)(data, n).GetResult();
+    header_[0] = FEND;
+    Append(header_, 1 + Stuff(header + 1, headerSize - 1, header_ + 1));
+    size_t size = n;
+    while(size) {
+        auto run = FindEscape(data, size);
+        if(run) {
+            Append(data, run);
+        }
+        if(run == size) {
+            break;
+        }
+        Append(data[run] == FEND ? escapedFend : escapedFesc, 2);
+        data += run + 1;
+        size -= run + 1;
+    }
+    Append(crcImage_, Stuff(&crc_, 1, crcImage_));
+    return count_;
+}
+
+size_t FrameDecoder::Feed(const uint8_t* data, size_t size)
+{
+    size_t total{};
+    while(total < size && WriteSpace()) {
+        size_t chunk = WriteSpace();
+        if(chunk > size - total) {
+            chunk = size - total;
+        }
+        memcpy(WritePtr(), data + total, chunk);
+        Commit(chunk);
+        total += chunk;
+    }
+    return total;
+}
+
+FrameDecoder::Status FrameDecoder::Decode(uint8_t& addr, uint8_t& cmd, uint8_t& n, uint8_t* data, size_t capacity)
+{
+    while(tail_ != head_) {
+        uint8_t b = ring_[tail_++ & RING_MASK];
+        if(b == FEND) { // start of the frame, also restarts the one that was cut off by noise
+            crc_.Reset(CRC_INIT)(b);
+            state_ = State::Addr;
+            escaped_ = false;
+            skipped_ = 0;
+            addr_ = 0;
+            continue;
+        }
+        if(state_ == State::Sync) {
+            if(++skipped_ >= SYNC_LIMIT) {
+                skipped_ = 0;
+                return Status::SyncError;
+            }
+            continue;
+        }
+        if(escaped_) {
+            escaped_ = false;
+            if(b == TFEND) {
+                b = FEND;
+            }
+            else if(b == TFESC) {
+                b = FESC;
+            }
+            else {
+                state_ = State::Sync;
+                return Status::StuffError;
+            }
+        }
+        else if(b == FESC) {
+            escaped_ = true;
+            continue;
+        }
+        switch(state_) {
+            case State::Addr:
+                if(b & 0x80) {
+                    addr_ = b & 0x7F; // ADD (b.7=1)
+                    state_ = State::Cmd;
+                }
+                else {
+                    cmd_ = b; // CMD (b.7=0)
+                    state_ = State::Len;
+                }
+                break;
+            case State::Cmd:
+                if(b & 0x80) {
+                    state_ = State::Sync;
+                    return Status::FormatError;
+                }
+                cmd_ = b;
+                state_ = State::Len;
+                break;
+            case State::Len:
+                if(b > capacity) {
+                    state_ = State::Sync;
+                    return Status::Overflow;
+                }
+                n_ = b;
+                index_ = 0;
+                state_ = n_ ? State::Data : State::Crc;
+                break;
+            case State::Data:
+                data[index_++] = b;
+                if(index_ == n_) {
+                    state_ = State::Crc;
+                }
+                break;
+            case State::Crc:
+                rxCrc_ = crc_.GetResult();
+                crc_(b);
+                state_ = State::Sync;
+                addr = addr_;
+                cmd = cmd_;
+                n = n_;
+                return crc_.GetResult() ? Status::CrcError : Status::Ok;
+            default:
+                break;
+        }
+        crc_(b);
+    }
+    return Status::Incomplete;
+}
+
+} // Wk
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2020 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "crc8.h"
+#include "iserialport.h"
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Wk {
+
+enum Symbols {
+    FEND = 0xC0,  // Frame END
+    FESC = 0xDB,  // Frame ESCape
+    TFEND = 0xDC, // Transposed Frame END
+    TFESC = 0xDD, // Transposed Frame ESCape
+
+    CRC_INIT = 0xDE // CRC Initial value
+};
+
+// Worst case: FEND plus every other byte of ADD, CMD, N, 255 data bytes and CRC escaped
+constexpr size_t MAX_FRAME_SIZE = 1 + 2 * (3 + 255 + 1);
+
+// Position of the first FEND or FESC, size if there is none. Scans a machine word per step.
+size_t FindEscape(const uint8_t* data, size_t size);
+
+// Byte stuffing of src into dst (2 * size bytes is always enough), returns the output size
+size_t Stuff(const uint8_t* src, size_t size, uint8_t* dst);
+
+// Builds the stuffed wire image of the frame in buf (MAX_FRAME_SIZE is always enough),
+// ADD byte is omitted for addr == 0. Returns the image size, crc receives the frame CRC.
+size_t EncodeFrame(uint8_t addr, uint8_t cmd, uint8_t n, const uint8_t* data, uint8_t* buf, uint8_t& crc);
+
+namespace Detail {
+
+struct FrameImage
+{
+    std::array<uint8_t, MAX_FRAME_SIZE> data{};
+    size_t size{};
+    uint8_t crc{};
+
+    constexpr void PutStuffed(uint8_t byte)
+    {
+        if(byte == FEND || byte == FESC) {
+            data[size++] = FESC;
+            data[size++] = byte == FEND ? TFEND : TFESC;
+        }
+        else {
+            data[size++] = byte;
+        }
+    }
+};
+
+// Same image as EncodeFrame, evaluated by the compiler
+template<size_t N>
+constexpr FrameImage BuildFrame(uint8_t addr, uint8_t cmd, const std::array<uint8_t, N>& payload)
+{
+    FrameImage image;
+    Mcudrv::Crc::Crc8 crc(CRC_INIT);
+    crc(FEND);
+    image.data[image.size++] = FEND;
+    if(addr) {
+        crc(addr | 0x80);
+        image.PutStuffed(addr | 0x80);
+    }
+    crc(cmd)(N);
+    image.PutStuffed(cmd);
+    image.PutStuffed(N);
+    for(auto byte : payload) {
+        crc(byte);
+        image.PutStuffed(byte);
+    }
+    image.crc = crc.GetResult();
+    image.PutStuffed(image.crc);
+    return image;
+}
+
+template<size_t Size>
+constexpr std::array<uint8_t, Size> Trim(const FrameImage& image)
+{
+    std::array<uint8_t, Size> result{};
+    for(size_t i = 0; i < Size; ++i) {
+        result[i] = image.data[i];
+    }
+    return result;
+}
+
+} // Detail
+
+// Frame with every field known at compile time, e.g. C_ON to a fixed node or group.
+// The stuffed wire image and the CRC are constants, sending one is a single WriteData.
+template<uint8_t Addr, uint8_t Cmd, uint8_t... Data>
+struct ConstFrame
+{
+    static_assert(Addr <= 0x7F && Cmd <= 0x7F, "address and command are 7 bit wide");
+
+    static constexpr uint8_t addr = Addr;
+    static constexpr uint8_t cmd = Cmd;
+    static constexpr uint8_t n = sizeof...(Data);
+    static constexpr std::array<uint8_t, n> payload{Data...};
+private:
+    static constexpr Detail::FrameImage built = Detail::BuildFrame(Addr, Cmd, payload);
+public:
+    static constexpr uint8_t crc = built.crc;
+    static constexpr std::array<uint8_t, built.size> image = Detail::Trim<built.size>(built);
+};
+
+// Wire image alone
+template<uint8_t Addr, uint8_t Cmd, uint8_t... Data>
+constexpr auto MakeFrame()
+{
+    return ConstFrame<Addr, Cmd, Data...>::image;
+}
+
+// Zero-copy form of EncodeFrame: the frame is described by segments for a gather write.
+// Escape-free runs of the payload are referenced in place, so the segments stay valid
+// while the payload and the encoder are alive and unchanged.
+class FrameEncoder
+{
+public:
+    // header, a run or an escape pair per payload byte at worst, CRC
+    static constexpr size_t MAX_SEGMENTS = 2 + 255;
+
+    // Returns the number of segments
+    size_t Encode(uint8_t addr, uint8_t cmd, uint8_t n, const uint8_t* data);
+    const IoSegment* GetSegments() const
+    {
+        return segments_.data();
+    }
+    size_t GetSegmentCount() const
+    {
+        return count_;
+    }
+    // Wire image size
+    size_t GetSize() const
+    {
+        return size_;
+    }
+    uint8_t GetCrc() const
+    {
+        return crc_;
+    }
+private:
+    std::array<IoSegment, MAX_SEGMENTS> segments_;
+    size_t count_{}, size_{};
+    uint8_t header_[1 + 2 * 3];
+    uint8_t crcImage_[2];
+    uint8_t crc_{};
+
+    void Append(const uint8_t* data, size_t size)
+    {
+        segments_[count_++] = {data, static_cast<uint32_t>(size)};
+        size_ += size;
+    }
+};
+
+// Incremental receiver side of the protocol. Raw bytes are pushed into the internal ring buffer
+// in whatever blocks the port returns, Decode() consumes them and keeps its position inside
+// the frame between calls, bytes following a complete frame stay in the buffer for the next one.
+class FrameDecoder
+{
+public:
+    enum class Status {
+        Incomplete, // more input is needed
+        Ok,
+        CrcError,
+        StuffError,  // FESC followed by anything but TFEND/TFESC
+        FormatError, // b.7 set in the command byte
+        Overflow,    // N exceeds the capacity of the destination buffer
+        SyncError    // no FEND within SYNC_LIMIT bytes
+    };
+    static constexpr size_t RING_SIZE = 1024;
+    static constexpr size_t SYNC_LIMIT = 512;
+
+    // Contiguous free space for the next port read, followed by Commit(bytes actually read)
+    uint8_t* WritePtr()
+    {
+        return &ring_[head_ & RING_MASK];
+    }
+    size_t WriteSpace() const
+    {
+        size_t free = RING_SIZE - (head_ - tail_);
+        size_t toEnd = RING_SIZE - (head_ & RING_MASK);
+        return free < toEnd ? free : toEnd;
+    }
+    void Commit(size_t size)
+    {
+        head_ += size;
+    }
+    // Copies as much as fits, returns the number of bytes taken
+    size_t Feed(const uint8_t* data, size_t size);
+    size_t Pending() const
+    {
+        return head_ - tail_;
+    }
+    bool InFrame() const
+    {
+        return state_ != State::Sync;
+    }
+    // Consumes buffered bytes until the frame is complete or the buffer runs dry.
+    // Payload bytes are written to data as they arrive, so the same buffer must be passed
+    // until the call returns something other than Incomplete. Header fields are assigned
+    // for Ok and CrcError results only.
+    Status Decode(uint8_t& addr, uint8_t& cmd, uint8_t& n, uint8_t* data, size_t capacity);
+    // Drops the partially received frame, buffered bytes are kept
+    void Resync()
+    {
+        state_ = State::Sync;
+        skipped_ = 0;
+    }
+    void Clear()
+    {
+        Resync();
+        head_ = tail_ = 0;
+    }
+    // CRC accumulated before the CRC byte of the last frame
+    uint8_t GetRxCrc() const
+    {
+        return rxCrc_;
+    }
+private:
+    static constexpr size_t RING_MASK = RING_SIZE - 1;
+    static_assert((RING_SIZE & RING_MASK) == 0, "RING_SIZE must be a power of 2");
+
+    enum class State : uint8_t { Sync, Addr, Cmd, Len, Data, Crc };
+
+    std::array<uint8_t, RING_SIZE> ring_;
+    size_t head_{}, tail_{};
+    size_t skipped_{};
+    Mcudrv::Crc::Crc8 crc_{CRC_INIT};
+    State state_{State::Sync};
+    bool escaped_{};
+    uint8_t addr_{}, cmd_{}, n_{}, index_{};
+    uint8_t rxCrc_{};
+};
+
+} // Wk
@@ -92,6 +92,11 @@ bool SerialPort::ResetStatus()
     return PurgeComm(hCom, PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR) != 0;
 }
 
+bool SerialPort::DiscardInput()
+{
+    return PurgeComm(hCom, PURGE_RXCLEAR) != 0;
+}
+
 bool SerialPort::Flush()
 {
     return FlushFileBuffers(hCom) != 0;
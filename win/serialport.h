@@ -39,6 +39,7 @@ public:
     bool WriteData(const uint8_t* data, uint32_t size) override;
     bool ReadByte(uint8_t& b) override;
     bool ResetStatus() override;
+    bool DiscardInput() override;
     bool Flush() override;
     bool setTimeout(uint32_t to) override;
 private:
@@ -21,6 +21,7 @@
  */
 
 #include "wsp32.h"
+#include <chrono>
 #include <iostream>
 
 using namespace Mcudrv;
@@ -33,208 +34,352 @@ static inline const char* GetErrorString(uint8_t err)
 }
 //--------------------------- Receive frame: --------------------------------
 
-bool Wake::RxFrame(uint32_t To, uint8_t& ADD, uint8_t& CMD, uint8_t& N, uint8_t* Data)
+bool Wake::RxFrame(uint32_t To, uint8_t& ADD, uint8_t& CMD, uint8_t& N, uint8_t* Data, size_t capacity)
 {
-    using namespace std;
-    if(ADD == ADDR_BROADCAST || (ADDR_GROUP_MIN <= ADD && ADD <= ADDR_GROUP_MAX)) {
+    if(IsNoReplyAddress(ADD)) {
         N = 0;
+        lastStatus_ = RequestStatus::Ok;
         return true;
     }
-    int i;
-    unsigned char b = 0;
-    Crc::Crc8 crc(CRC_INIT); // init CRC
     port_.SetTimeout(To);
-#ifdef DEBUG_MODE
-    debugInfo_.timeoutSuccess = true;
-#endif
-    for(i = 0; i < 512 && b != FEND; i++) {
-        if(!port_.ReadByte(b))
-            break; // frame synchronization
-    }
-    if(b != FEND) {
-        return 0; // timeout or sync error
-    }
-#ifdef DEBUG_MODE
-    else {
-        debugInfo_.syncSuccess = true;
-    }
-    debugInfo_.staffingSuccess = true;
-#endif
-    crc(b); // update CRC
-    N = ADD = 0;
-    for(i = -3; i <= N; i++) {
-        if(!port_.ReadByte(b)) {
-#ifdef DEBUG_MODE
-            debugInfo_.syncSuccess = false;
-#endif
-            break; // timeout error
+    auto addr = ADD;
+    auto timeout = To;
+    auto status = decoder_.Decode(ADD, CMD, N, Data, capacity);
+    while(status == FrameDecoder::Status::Incomplete) {
+        if(decoder_.InFrame() && timeout != interByteTimeout_) {
+            timeout = interByteTimeout_;
+            port_.SetTimeout(timeout);
         }
-        if(b == FESC) {
-            if(!port_.ReadByte(b)) {
-#ifdef DEBUG_MODE
-                debugInfo_.syncSuccess = false;
-#endif
-                break; // timeout error
+        // one read per burst, the decoder resumes from where the previous block ended
+        auto received = port_.ReadSome(decoder_.WritePtr(), static_cast<uint32_t>(decoder_.WriteSpace()));
+        if(!received) {
+            // a reply cut short is more likely noise than a missing node
+            if(decoder_.InFrame()) {
+                stats_.Add(addr, WakeStats::FORMAT_ERRORS);
+                lastStatus_ = RequestStatus::FrameError;
             }
             else {
-                if(b == TFEND) {
-                    b = FEND; // TFEND <- FEND
-                }
-                else if(b == TFESC) {
-                    b = FESC; // TFESC <- FESC
-                }
-                else {
-#ifdef DEBUG_MODE
-                    debugInfo_.staffingSuccess = false;
-#endif
-                    break;
-                }
+                stats_.Add(addr, WakeStats::TIMEOUTS);
+                lastStatus_ = RequestStatus::Timeout;
             }
+            decoder_.Resync();
+            return false; // timeout error
         }
-        if(i == -3) {
-            if(b & 0x80) {
-                ADD = b & 0x7F; // ADD (b.7=1)
-            }
-            else {
-                CMD = b; // CMD (b.7=0)
-                i++;
-            }
-        }
-        else if(i == -2) {
-            if(b & 0x80) {
-                break; // CMD error (b.7=1)
-            }
-            else {
-                CMD = b; // CMD
-            }
-        }
-        else if(i == -1) {
-            N = b; // N
-        }
-        else if(i < N) {
-            Data[i] = b; // data
-        }
-        else { // if(i == N)
-            RxCrc_ = crc.GetResult();
-        }
-        crc(b); // update CRC
+        stats_.Add(addr, WakeStats::RX_BYTES, received);
+        decoder_.Commit(received);
+        status = decoder_.Decode(ADD, CMD, N, Data, capacity);
+    }
+    RxCrc_ = decoder_.GetRxCrc();
+    stats_.AddDecoded(addr, status);
+    switch(status) {
+        case FrameDecoder::Status::Ok:
+            lastStatus_ = RequestStatus::Ok;
+            break;
+        case FrameDecoder::Status::CrcError:
+            lastStatus_ = RequestStatus::CrcError;
+            break;
+        default:
+            lastStatus_ = RequestStatus::FrameError;
+            break;
     }
-#ifdef DEBUG_MODE
-    debugInfo_.crcSuccess = !crc.GetResult();
-#endif
-    return ((i == N + 1) && !crc.GetResult()); // RX or CRC error
+    return status == FrameDecoder::Status::Ok; // RX or CRC error
 }
 
 //--------------------------- Transmit frame: -------------------------------
 
-bool Wake::TxFrame(uint8_t ADDR, uint8_t CMD, uint8_t N, uint8_t* Data)
+bool Wake::TxFrame(uint8_t ADDR, uint8_t CMD, uint8_t N, const uint8_t* Data)
 {
-    unsigned char Buff[280];
-    uint32_t j = 0;
-    unsigned char d;
-    Crc::Crc8 crc(CRC_INIT);
-    for(int i = -4; i <= N; ++i) {
-        if(i == -3 && !ADDR) {
-            ++i;
-        }
-        if(i == -4) {
-            d = FEND;
-        }
-        else if(i == -3) { // FEND
-            d = ADDR | 0x80;
+    bool result;
+    size_t size;
+    if(N < ZERO_COPY_MIN_SIZE) {
+        uint8_t Buff[MAX_FRAME_SIZE];
+        size = EncodeFrame(ADDR, CMD, N, Data, Buff, TxCrc_);
+        result = port_.WriteData(Buff, static_cast<uint32_t>(size));
+    }
+    else {
+        encoder_.Encode(ADDR, CMD, N, Data);
+        TxCrc_ = encoder_.GetCrc();
+        size = encoder_.GetSize();
+        result = port_.WriteDataV(encoder_.GetSegments(), encoder_.GetSegmentCount());
+    }
+    return OnTransmit(ADDR, size, result);
+}
+
+bool Wake::TxImage(uint8_t addr, uint8_t crc, const uint8_t* image, size_t size)
+{
+    TxCrc_ = crc;
+    return OnTransmit(addr, size, port_.WriteData(image, static_cast<uint32_t>(size)));
+}
+
+bool Wake::OnTransmit(uint8_t addr, size_t size, bool result)
+{
+    if(!result) {
+        lastStatus_ = RequestStatus::TxError;
+        stats_.Add(addr, WakeStats::TX_ERRORS);
+        return false;
+    }
+    stats_.Add(addr, WakeStats::TX_FRAMES);
+    stats_.Add(addr, WakeStats::TX_BYTES, size);
+    return true;
+}
+
+bool Wake::GetInfo(Packet_t& packet)
+{
+    auto info = GetInfo(packet.addr);
+    if(!info) {
+        if(infoError_ != ERR_NO) {
+            std::cerr << "Common Info request failed with device response: " << GetErrorString(infoError_) << "\r\n";
         }
-        else if(i == -2) { // address
-            d = CMD;
+        else {
+            std::cerr << ">>> Common Info request failed (maybe bootloader already running)\r\n";
         }
-        else if(i == -1) { // command
-            d = N;
+        return false;
+    }
+    info->Print(cout);
+    return true;
+}
+
+std::optional<DeviceInfo> Wake::GetInfo(uint8_t addr, bool refresh)
+{
+    if(!refresh) {
+        auto it = infoCache_.find(addr);
+        if(it != infoCache_.end()) {
+            return it->second;
         }
-        else if(i == N) { // N
-            TxCrc_ = d = crc.GetResult();
+    }
+    Packet_t packet{addr, C_GETINFO, {}}; // common request
+    infoError_ = ERR_NO;
+    if(!Request(packet) || !packet.n) {
+        return std::nullopt;
+    }
+    if(packet.payload[0] != ERR_NO) {
+        infoError_ = packet.payload[0];
+        return std::nullopt;
+    }
+    if(packet.n < 3) {
+        return std::nullopt;
+    }
+    DeviceInfo info;
+    info.deviceMask = packet.payload[1];
+    info.protocolVersion = packet.payload[2];
+    bool complete = true;
+    for(size_t i{}; i < DEV_TYPES_NUMBER; ++i) {
+        if(!(info.deviceMask & (1U << i))) {
+            continue;
         }
-        else {
-            d = Data[i]; // data
+        auto& module = info.modules.emplace_back(ModuleInfo{DeviceType(i)});
+        packet = Packet_t{addr, C_GETINFO, {static_cast<uint8_t>(i)}}; // device info request
+        if(!Request(packet) || packet.n < 2 || packet.payload[0] != ERR_NO) {
+            complete = false;
+            continue;
         }
-        crc(d);
-        if(i > -4) {
-            if(d == FEND || d == FESC) {
-                Buff[j++] = FESC;
-                d = (d == FEND ? TFEND : TFESC);
-            }
+        module.valid = true;
+        auto data = packet.payload[1];
+        switch(module.type) {
+            case DEV_LED_DRIVER:
+                module.channels = data & 0x01 ? 2 : 1;
+                module.fanController = data & 0x02;
+                break;
+            case DEV_POWER_SWITCH:
+            case DEV_RGB_LED_DRIVER:
+                module.channels = data;
+                break;
+            case DEV_GENERIC_IO:
+                module.memorySize = data;
+                break;
+            case DEV_SENSOR:
+                module.sensorMask = data;
+                break;
+            case DEV_POWER_SUPPLY:
+                module.nominalPower = packet.n == 2 ? data : data | packet.payload[2] << 8;
+                break;
+            case DEV_CUSTOM:
+                module.id = data;
+                break;
+            default:
+                break;
         }
-        Buff[j++] = d;
     }
-    return port_.WriteData(Buff, j);
+    // a module that didn't answer is asked again next time
+    if(complete) {
+        infoCache_[addr] = info;
+    }
+    return info;
 }
 
-bool Wake::GetInfo(Packet_t& packet)
+void Wake::InvalidateInfo(uint8_t addr)
 {
-    packet.cmd = C_GETINFO;
-    packet.n = 0; // common request
-    if(!Request(packet, 50)) {
-        std::cerr << ">>> Common Info request failed (maybe bootloader already running)\r\n";
+    if(addr == ADDR_BROADCAST) {
+        infoCache_.clear();
+    }
+    else {
+        infoCache_.erase(addr);
+    }
+}
+
+bool Wake::Request(Packet_t& packet, uint32_t To, bool adaptive)
+{
+    OnRequest(packet.View());
+    auto addr = packet.addr;
+    auto cmd = packet.cmd;
+    auto newAddr = packet.n ? packet.payload[0] : addr;
+    DiscardInput();
+    if(!TxFrame(packet)) {
         return false;
     }
-    if(packet.payload[0]) {
-        std::cerr << "Common Info request failed with device response: " << GetErrorString(packet.payload[0]) << endl;
+    return Receive(addr, cmd, newAddr, To, adaptive, packet.addr, packet.cmd, packet.n, packet.payload.data(),
+                   Packet_t::BUF_SIZE);
+}
+
+bool Wake::Request(const PacketView& request, MutablePacketView& reply, uint32_t To, bool adaptive)
+{
+    if(request.payload.size() > UINT8_MAX) {
         return false;
     }
-    auto data = &packet.payload[1];
-    cout << ">>> User Firmware Information\r\n";
-    cout << "Protocol Version: " << (static_cast<uint32_t>(data[1] >> 4)) << '.'
-         << (static_cast<uint32_t>(data[1]) & 0x0F) << "\r\n";
-    auto deviceMask = *data;
-    cout << "Available modules: \r\n";
-    for(size_t i{}; i < DEV_TYPES_NUMBER; ++i) {
-        if(deviceMask & (1U << i)) {
-            cout << "\t" << deviceTypeStr[i] << "\r\n";
-            packet.n = 1;                                // device info request
-            packet.payload[0] = static_cast<uint8_t>(i); // device select
-            if(!Request(packet, 50)) {
-                std::cerr << ">>> Device Info request failed\r\n";
-                continue;
+    OnRequest(request);
+    auto n = static_cast<uint8_t>(request.payload.size());
+    auto newAddr = n ? request.payload[0] : request.addr;
+    DiscardInput();
+    if(!TxFrame(request.addr, request.cmd, n, request.payload.data())) {
+        return false;
+    }
+    uint8_t received{};
+    if(!Receive(request.addr, request.cmd, newAddr, To, adaptive, reply.addr, reply.cmd, received,
+                reply.payload.data(), reply.payload.size())) {
+        return false;
+    }
+    reply.payload = reply.payload.first(received);
+    return true;
+}
+
+bool Wake::Receive(uint8_t addr,
+                   uint8_t cmd,
+                   uint8_t newAddr,
+                   uint32_t To,
+                   bool adaptive,
+                   uint8_t& ADD,
+                   uint8_t& CMD,
+                   uint8_t& N,
+                   uint8_t* Data,
+                   size_t capacity)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(To);
+    bool result;
+    while(true) {
+        ADD = addr;
+        result = RxFrame(To, ADD, CMD, N, Data, capacity);
+        // a frame from another node is a late reply to a timed out request, skip it
+        if(!result || IsNoReplyAddress(addr) || !ADD || ADD == addr || (cmd == C_SETNODEADDRESS && ADD == newAddr)) {
+            break;
+        }
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if(left.count() <= 0) {
+            stats_.Add(addr, WakeStats::TIMEOUTS);
+            lastStatus_ = RequestStatus::Timeout;
+            result = false;
+            break;
+        }
+        To = static_cast<uint32_t>(left.count());
+    }
+    if(cmd == C_SETNODEADDRESS) {
+        // the estimates of both addresses belong to other nodes now
+        rto_.Reset(addr);
+        rto_.Reset(newAddr);
+        return result;
+    }
+    if(IsNoReplyAddress(addr)) {
+        return result;
+    }
+    if(result) {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        rto_.AddSample(addr, latency);
+        stats_.AddLatency(cmd, latency);
+    }
+    // a fixed timeout may be shorter than the estimate, that miss says nothing about the node
+    else if(adaptive && lastStatus_ == RequestStatus::Timeout) {
+        rto_.OnTimeout(addr);
+    }
+    return result;
+}
+
+void Wake::OnRequest(const PacketView& packet)
+{
+    switch(packet.cmd) {
+        case C_SETNODEADDRESS:
+            if(!packet.payload.empty()) {
+                InvalidateInfo(packet.payload[0]);
+            }
+            [[fallthrough]];
+        case C_SAVESETTINGS:
+        case C_REBOOT:
+            // group members aren't known here
+            if(IsNoReplyAddress(packet.addr)) {
+                InvalidateInfo();
             }
-            switch(DeviceType(i)) {
-                case Wk::DEV_LED_DRIVER:
-                    cout << "\t\tChannels Number: " << (*data & 0x01 ? 2 : 1) << "\r\n";
-                    cout << "\t\tFan Controller present: " << (*data & 0x02 ? "Yes" : "No") << "\r\n";
-                    break;
-                case Wk::DEV_POWER_SWITCH:
-                case Wk::DEV_RGB_LED_DRIVER:
-                    cout << "\t\tChannels Number: " << static_cast<uint32_t>(*data) << "\r\n";
-                    break;
-                case Wk::DEV_GENERIC_IO:
-                    cout << "\t\tMemory area size available: " << static_cast<uint32_t>(*data) << "\r\n";
-                    break;
-                case Wk::DEV_SENSOR:
-                    for(uint8_t i{}; i < sizeof(sensorTypeStr); ++i) {
-                        if(*data & (1U << i)) {
-                            cout << "\t\tType: " << sensorTypeStr[i] << "\r\n";
-                        }
-                    }
-                    break;
-                case Wk::DEV_POWER_SUPPLY:
-                    cout << "\t\tNominal Power: ";
-                    if(packet.n == 2) {
-                        cout << static_cast<uint32_t>(*data) << "W\r\n";
-                    }
-                    else {
-                        cout << *(reinterpret_cast<uint16_t*>(data)) << "W\r\n";
-                    }
-                    break;
-                case Wk::DEV_RESERVED:
-                    cout << "\t\tReserved"
-                         << "\r\n";
-                    break;
-                case Wk::DEV_CUSTOM:
-                    cout << "\t\tID: " << static_cast<uint32_t>(*data) << "\r\n";
-                    break;
-                default:
-                    break;
+            else {
+                InvalidateInfo(packet.addr);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+std::vector<SensorType> DeviceInfo::GetSensorTypes() const
+{
+    std::vector<SensorType> types;
+    if(auto sensor = GetModule(DEV_SENSOR)) {
+        for(size_t i{}; i < SEN_TYPES_NUMBER; ++i) {
+            if(sensor->sensorMask & (1U << i)) {
+                types.push_back(SensorType(i));
             }
         }
     }
-    return true;
+    return types;
+}
+
+void DeviceInfo::Print(std::ostream& os) const
+{
+    os << ">>> User Firmware Information\r\n";
+    os << "Protocol Version: " << (protocolVersion >> 4) << '.' << (protocolVersion & 0x0F) << "\r\n";
+    os << "Available modules: \r\n";
+    for(const auto& module : modules) {
+        os << "\t" << deviceTypeStr[module.type] << "\r\n";
+        if(!module.valid) {
+            os << "\t\tDevice Info request failed\r\n";
+            continue;
+        }
+        switch(module.type) {
+            case DEV_LED_DRIVER:
+                os << "\t\tChannels Number: " << static_cast<uint32_t>(module.channels) << "\r\n";
+                os << "\t\tFan Controller present: " << (module.fanController ? "Yes" : "No") << "\r\n";
+                break;
+            case DEV_POWER_SWITCH:
+            case DEV_RGB_LED_DRIVER:
+                os << "\t\tChannels Number: " << static_cast<uint32_t>(module.channels) << "\r\n";
+                break;
+            case DEV_GENERIC_IO:
+                os << "\t\tMemory area size available: " << static_cast<uint32_t>(module.memorySize) << "\r\n";
+                break;
+            case DEV_SENSOR:
+                for(auto type : GetSensorTypes()) {
+                    os << "\t\tType: " << sensorTypeStr[type] << "\r\n";
+                }
+                break;
+            case DEV_POWER_SUPPLY:
+                os << "\t\tNominal Power: " << module.nominalPower << "W\r\n";
+                break;
+            case DEV_RESERVED:
+                os << "\t\tReserved\r\n";
+                break;
+            case DEV_CUSTOM:
+                os << "\t\tID: " << static_cast<uint32_t>(module.id) << "\r\n";
+                break;
+            default:
+                break;
+        }
+    }
 }
 
 const char* GetErrorString(Err err)
@@ -26,47 +26,21 @@
 
 #include "crc8.h"
 #include "iserialport.h"
+#include "rtoestimator.h"
+#include "stats.h"
+#include "wakecodec.h"
 #include <array>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <span>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace Wk {
 
-#ifdef DEBUG_MODE
-union DebugInfo
-{
-    struct
-    {
-        unsigned txSuccess : 1;
-        unsigned rxSuccess : 1;
-        unsigned timeoutSuccess : 1;
-        unsigned syncSuccess : 1;
-        unsigned crcSuccess : 1;
-        unsigned staffingSuccess : 1;
-    };
-    operator bool()
-    {
-        return data != 0x3F;
-    }
-    void Print()
-    {
-        using namespace std;
-        cout.setf(cout.boolalpha);
-        cout << "TX success: " << (bool)txSuccess << endl;
-        cout << "RX success: " << (bool)rxSuccess << endl;
-        cout << "Timeout success: " << (bool)timeoutSuccess << endl;
-        cout << "Sync success:" << (bool)syncSuccess << endl;
-        cout << "CRC success: " << (bool)crcSuccess << endl;
-        cout << "Staffing success: " << (bool)staffingSuccess << endl;
-        cout.unsetf(cout.boolalpha);
-    }
-private:
-    uint32_t data;
-};
-#endif
-
 enum Cmd {
     C_NOP,  //нет операции
     C_ERR,  //ошибка приема пакета
@@ -79,7 +53,11 @@ enum Cmd {
     C_ON,
     C_TOGGLE_ONOFF,
     C_SAVESETTINGS,
-    C_REBOOT
+    C_REBOOT,
+    C_BULK_BEGIN,  // bulk transfer, see bulktransfer.h
+    C_BULK_DATA,
+    C_BULK_STATUS,
+    C_BULK_END
 };
 
 enum Err {
@@ -95,6 +73,15 @@ enum Err {
     ERR_EEPROMUNLOCK // EEPROM wasn't unlocked
 };
 
+enum class RequestStatus {
+    Ok,
+    TxError,
+    Timeout,
+    CrcError,
+    FrameError, // sync, stuffing or format error
+    Cancelled
+};
+
 enum DeviceType {
     DEV_LED_DRIVER,
     DEV_POWER_SWITCH,
@@ -125,6 +112,24 @@ constexpr static std::array<const char*, SEN_TYPES_NUMBER> sensorTypeStr =
 
 enum AddressTypes { ADDR_BROADCAST = 0, ADDR_GROUP_MIN = 80, ADDR_GROUP_MAX = 95 };
 
+// Frames to these addresses are not answered
+constexpr bool IsNoReplyAddress(uint8_t addr)
+{
+    return addr == ADDR_BROADCAST || (ADDR_GROUP_MIN <= addr && addr <= ADDR_GROUP_MAX);
+}
+
+// Packet that doesn't own its payload, the caller keeps the storage alive
+template<typename T>
+struct BasicPacketView
+{
+    uint8_t addr{};
+    uint8_t cmd{};
+    std::span<T> payload;
+};
+using PacketView = BasicPacketView<const uint8_t>;
+// On input the payload is the storage for the reply, on success it is narrowed to the received bytes
+using MutablePacketView = BasicPacketView<uint8_t>;
+
 struct Packet_t
 {
     static constexpr size_t BUF_SIZE = 160;
@@ -143,6 +148,43 @@ struct Packet_t
     uint8_t cmd{};
     uint8_t n{};
     std::array<uint8_t, BUF_SIZE> payload{};
+
+    PacketView View() const
+    {
+        return {addr, cmd, {payload.data(), n}};
+    }
+};
+
+// Reply of a module info request
+struct ModuleInfo
+{
+    DeviceType type;
+    bool valid{};            // false if the module didn't answer
+    uint8_t channels{};      // LED, RGB LED drivers and power switches
+    bool fanController{};    // LED driver
+    uint8_t memorySize{};    // generic IO
+    uint8_t sensorMask{};    // SensorType bits
+    uint16_t nominalPower{}; // W, power supply
+    uint8_t id{};            // custom device
+};
+
+struct DeviceInfo
+{
+    uint8_t protocolVersion{}; // major.minor in the high and low nibbles
+    uint8_t deviceMask{};      // DeviceType bits
+    std::vector<ModuleInfo> modules;
+
+    const ModuleInfo* GetModule(DeviceType type) const
+    {
+        for(const auto& module : modules) {
+            if(module.type == type) {
+                return &module;
+            }
+        }
+        return nullptr;
+    }
+    std::vector<SensorType> GetSensorTypes() const;
+    void Print(std::ostream& os) const;
 };
 
 using std::cout;
@@ -155,20 +197,20 @@ class Wake
 {
 private:
     enum {
-        FEND = 0xC0,  // Frame END
-        FESC = 0xDB,  // Frame ESCape
-        TFEND = 0xDC, // Transposed Frame END
-        TFESC = 0xDD, // Transposed Frame ESCape
-
-        CRC_INIT = 0xDE, // CRC Initial value
-        DEFAULT_RX_TIMEOUT_MS = 50
+        DEFAULT_INTERBYTE_TIMEOUT_MS = 20,
+        ZERO_COPY_MIN_SIZE = 64 // shorter payloads are cheaper to copy than to gather
     };
 
     ISerialPort& port_;
+    FrameDecoder decoder_;
+    FrameEncoder encoder_;
+    uint32_t interByteTimeout_{DEFAULT_INTERBYTE_TIMEOUT_MS};
     uint8_t TxCrc_, RxCrc_;
-#ifdef DEBUG_MODE
-    DebugInfo debugInfo_{};
-#endif
+    RequestStatus lastStatus_{RequestStatus::Ok};
+    std::map<uint8_t, DeviceInfo> infoCache_;
+    uint8_t infoError_{ERR_NO}; // device error code of the last failed common info request
+    RtoEstimator rto_;
+    WakeStats stats_;
 public:
     Wake(ISerialPort& port) : port_{port}, TxCrc_(0), RxCrc_(0)
     {
@@ -185,28 +227,83 @@ public:
         connected = port_.OpenCOM();
         return connected;
     }
+    // The Request timeout waits for the first byte of the reply, this one for each next block of it
+    void SetInterByteTimeout(uint32_t to)
+    {
+        interByteTimeout_ = to;
+    }
+    uint32_t GetInterByteTimeout() const
+    {
+        return interByteTimeout_;
+    }
+    // 0 if unknown
+    uint32_t GetBaudRate() const
+    {
+        return port_.GetBaudRate();
+    }
+    ISerialPort& GetPort()
+    {
+        return port_;
+    }
+    // Prints the device info of packet.addr
     bool GetInfo(Packet_t& packet);
-#ifndef DEBUG_MODE
-    bool Request(Packet_t& packet, uint32_t To = DEFAULT_RX_TIMEOUT_MS)
+    // Served from the cache unless refresh is set, the cache entry is dropped by the commands that change the node
+    std::optional<DeviceInfo> GetInfo(uint8_t addr, bool refresh = false);
+    // All the addresses if addr is 0
+    void InvalidateInfo(uint8_t addr = ADDR_BROADCAST);
+    // The timeout follows the reply latency of the node
+    bool Request(Packet_t& packet)
     {
-        return TxFrame(packet) && RxFrame(packet, To);
+        return Request(packet, rto_.GetTimeout(packet.addr), true);
     }
-#else // DEBUG_MODE
-    auto Request(Packet_t& packet, uint32_t To)
+    bool Request(Packet_t& packet, uint32_t To)
     {
-        if(TxFrame(packet)) {
-            debugInfo_.txSuccess = true;
-            if(!packet.addr) {
-                debugInfo_.rxSuccess = true;
-                return debugInfo_;
-            }
-            if(RxFrame(packet, To)) {
-                debugInfo_.rxSuccess = true;
-            }
+        return Request(packet, To, false);
+    }
+    // Nothing is copied, the reply payload is decoded straight into the storage of reply
+    bool Request(const PacketView& request, MutablePacketView& reply)
+    {
+        return Request(request, reply, rto_.GetTimeout(request.addr), true);
+    }
+    bool Request(const PacketView& request, MutablePacketView& reply, uint32_t To)
+    {
+        return Request(request, reply, To, false);
+    }
+    // Prebuilt frame, only the reply is decoded at run time
+    template<uint8_t Addr, uint8_t Cmd, uint8_t... Data>
+    bool Request(ConstFrame<Addr, Cmd, Data...> frame, Packet_t& reply)
+    {
+        return Request(frame, reply, rto_.GetTimeout(Addr), true);
+    }
+    template<uint8_t Addr, uint8_t Cmd, uint8_t... Data>
+    bool Request(ConstFrame<Addr, Cmd, Data...> frame, Packet_t& reply, uint32_t To)
+    {
+        return Request(frame, reply, To, false);
+    }
+    // Prebuilt frame to a broadcast or group address
+    template<uint8_t Addr, uint8_t Cmd, uint8_t... Data>
+    bool Send(ConstFrame<Addr, Cmd, Data...> frame)
+    {
+        static_assert(IsNoReplyAddress(Addr), "the node replies, use Request");
+        if constexpr(Cmd == C_SETNODEADDRESS || Cmd == C_SAVESETTINGS || Cmd == C_REBOOT) {
+            OnRequest(PacketView{Addr, Cmd, frame.payload});
+        }
+        return TxImage(Addr, frame.crc, frame.image.data(), frame.image.size());
+    }
+    // Frame the node doesn't answer: broadcast, group or a command defined as unacknowledged
+    bool Send(const PacketView& packet)
+    {
+        if(packet.payload.size() > UINT8_MAX) {
+            return false;
         }
-        return debugInfo_;
+        OnRequest(packet);
+        return TxFrame(packet.addr, packet.cmd, static_cast<uint8_t>(packet.payload.size()), packet.payload.data());
+    }
+    // Waits until the frames written so far are on the wire
+    bool Flush()
+    {
+        return port_.Flush();
     }
-#endif
     uint8_t GetTxCrc() const
     {
         return TxCrc_;
@@ -215,6 +312,19 @@ public:
     {
         return RxCrc_;
     }
+    const WakeStats& GetStats() const
+    {
+        return stats_;
+    }
+    RtoEstimator& GetRtoEstimator()
+    {
+        return rto_;
+    }
+    // Why the last Request failed
+    RequestStatus GetLastStatus() const
+    {
+        return lastStatus_;
+    }
     ~Wake()
     {
         port_.CloseCOM();
@@ -222,8 +332,49 @@ public:
 private:
     bool connected;
 
-    bool RxFrame(uint32_t To, uint8_t& ADD, uint8_t& CMD, uint8_t& N, uint8_t* Data);
-    bool TxFrame(uint8_t ADDR, uint8_t CMD, uint8_t N, uint8_t* Data);
+    void OnRequest(const PacketView& packet);
+    // Bytes left from an earlier exchange, like a late reply, must not pass for the reply to this one
+    void DiscardInput()
+    {
+        decoder_.Clear();
+        port_.DiscardInput();
+    }
+    bool Request(Packet_t& packet, uint32_t To, bool adaptive);
+    bool Request(const PacketView& request, MutablePacketView& reply, uint32_t To, bool adaptive);
+    template<uint8_t Addr, uint8_t Cmd, uint8_t... Data>
+    bool Request(ConstFrame<Addr, Cmd, Data...> frame, Packet_t& reply, uint32_t To, bool adaptive)
+    {
+        if constexpr(Cmd == C_SETNODEADDRESS || Cmd == C_SAVESETTINGS || Cmd == C_REBOOT) {
+            OnRequest(PacketView{Addr, Cmd, frame.payload});
+        }
+        uint8_t newAddr = Addr;
+        if constexpr(sizeof...(Data) > 0) {
+            newAddr = frame.payload[0];
+        }
+        DiscardInput();
+        if(!TxImage(Addr, frame.crc, frame.image.data(), frame.image.size())) {
+            return false;
+        }
+        return Receive(Addr, Cmd, newAddr, To, adaptive, reply.addr, reply.cmd, reply.n, reply.payload.data(),
+                       Packet_t::BUF_SIZE);
+    }
+    // The request is on the wire, waits for the reply and does the bookkeeping
+    bool Receive(uint8_t addr,
+                 uint8_t cmd,
+                 uint8_t newAddr,
+                 uint32_t To,
+                 bool adaptive,
+                 uint8_t& ADD,
+                 uint8_t& CMD,
+                 uint8_t& N,
+                 uint8_t* Data,
+                 size_t capacity);
+    bool TxImage(uint8_t addr, uint8_t crc, const uint8_t* image, size_t size);
+    bool OnTransmit(uint8_t addr, size_t size, bool result);
+
+    bool RxFrame(uint32_t To, uint8_t& ADD, uint8_t& CMD, uint8_t& N, uint8_t* Data,
+                 size_t capacity = Packet_t::BUF_SIZE);
+    bool TxFrame(uint8_t ADDR, uint8_t CMD, uint8_t N, const uint8_t* Data);
     bool RxFrame(Packet_t& packet, uint32_t To)
     {
         return RxFrame(To, packet.addr, packet.cmd, packet.n, packet.payload.data());